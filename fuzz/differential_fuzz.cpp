@@ -0,0 +1,348 @@
+// Differential fuzzing of the converter against the scalar frame path.
+//
+// The oracle unpacks, converts and packs every frame as a whole with ReadFrame/ConvertFrom/WriteFrame on one
+// thread. The same input then goes through FrameConverter with the faster paths (worker threads, --strip, a
+// second output, duplicate detection, the bands of --max-memory) and the outputs must match byte for byte. A case
+// is decoded from the fuzzer input: the format pair, the size, alignment, replication, crop and thread count, then
+// the pixels.
+//
+// Without libFuzzer the binary runs every format pair once and then random cases:
+//     differential_fuzz [iterations] [seed]
+// Built with -DDIFFERENTIAL_FUZZ_LIBFUZZER and -fsanitize=fuzzer it is a regular libFuzzer target.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/frame_converter.hpp"
+
+namespace
+{
+    // In-memory files shared by the streams, keyed by name
+    std::map<std::string, std::vector<char>> g_files;
+
+    class MemoryIStream final
+    {
+    public:
+        void open(const std::string& filename, std::ios_base::openmode)
+        {
+            m_data = &g_files[filename];
+            m_pos = 0;
+            m_good = true;
+        }
+
+        MemoryIStream& read(char* s, std::streamsize n)
+        {
+            m_gcount = std::max<std::streamsize>(0, std::min<std::streamsize>(n, m_data->size() - m_pos));
+            std::memcpy(s, m_data->data() + m_pos, m_gcount);
+            m_pos += m_gcount;
+            m_good = m_gcount == n;
+
+            return *this;
+        }
+
+        MemoryIStream& seekg(std::streampos pos)
+        {
+            return seekg(static_cast<std::streamoff>(pos), std::ios_base::beg);
+        }
+
+        MemoryIStream& seekg(std::streamoff off, std::ios_base::seekdir dir)
+        {
+            m_pos = dir == std::ios_base::end ? m_data->size() + off : dir == std::ios_base::cur ? m_pos + off : off;
+
+            return *this;
+        }
+
+        std::streampos tellg() const
+        {
+            return m_pos;
+        }
+
+        std::streamsize gcount() const
+        {
+            return m_gcount;
+        }
+
+        void clear()
+        {
+            m_good = true;
+        }
+
+        operator bool() const
+        {
+            return m_good;
+        }
+
+    private:
+        std::vector<char>* m_data = nullptr;
+        std::streamoff m_pos = 0;
+        std::streamsize m_gcount = 0;
+        bool m_good = false;
+    };
+
+    class MemoryOStream final
+    {
+    public:
+        void open(const std::string& filename, std::ios_base::openmode)
+        {
+            m_data = &g_files[filename];
+            m_data->clear();
+            m_pos = 0;
+        }
+
+        MemoryOStream& write(const char* s, std::streamsize n)
+        {
+            m_data->resize(std::max<size_t>(m_data->size(), m_pos + n));
+            std::memcpy(m_data->data() + m_pos, s, n);
+            m_pos += n;
+
+            return *this;
+        }
+
+        MemoryOStream& seekp(std::streampos pos)
+        {
+            m_pos = pos;
+
+            return *this;
+        }
+
+        operator bool() const
+        {
+            return m_data != nullptr;
+        }
+
+    private:
+        std::vector<char>* m_data = nullptr;
+        size_t m_pos = 0;
+    };
+
+    constexpr size_t TYPE_NUM = sizeof(frame::TYPES) / sizeof(frame::TYPES[0]);
+
+    struct Case
+    {
+        const char* typeIn;
+        const char* typeOut;
+        size_t w;
+        size_t h;
+        size_t align;
+        bool replicate;
+        bool crop;
+        size_t cropX;
+        size_t cropY;
+        size_t cropW;
+        size_t cropH;
+        size_t frames;
+        size_t threads;
+        size_t stripRows;
+    };
+
+    std::string Describe(const Case& c)
+    {
+        std::string s = std::string(c.typeIn) + " -> " + c.typeOut + " " + std::to_string(c.w) + "x" + std::to_string(c.h) +
+            " align " + std::to_string(c.align) + " replicate " + std::to_string(c.replicate);
+        if (c.crop)
+        {
+            s += " crop " + std::to_string(c.cropX) + "," + std::to_string(c.cropY) + "," + std::to_string(c.cropW) + "," + std::to_string(c.cropH);
+        }
+
+        return s;
+    }
+
+    // Whole frames through the scalar Frame methods, one at a time
+    std::vector<char> Reference(const Case& c, const std::vector<char>& input, size_t& slotSz)
+    {
+        const size_t w = c.crop ? c.cropW : c.w;
+        const size_t h = c.crop ? c.cropH : c.h;
+        std::unique_ptr<frame::Frame> in(frame::Create(c.typeIn, w, h, "Input"));
+        std::unique_ptr<frame::Frame> out(frame::Create(c.typeOut, w, h, "Output"));
+        if (c.crop)
+        {
+            in->SetCrop(c.w, c.h, c.cropX, c.cropY);
+        }
+        in->SetPadding(c.align, c.replicate);
+        out->SetPadding(c.align, c.replicate);
+        in->Allocate();
+
+        const size_t szIn = in->FrameSize(false);
+        const size_t szOut = out->FrameSize(true);
+        slotSz = szIn + szOut + in->RawSize() + out->RawSize();
+        std::vector<char> output(szOut * c.frames);
+        for (size_t f = 0; f < c.frames; f++)
+        {
+            in->ReadFrame(input.data() + szIn * f);
+            out->ConvertFrom(*in);
+            out->WriteFrame(output.data() + szOut * f);
+        }
+
+        return output;
+    }
+
+    int Convert(const Case& c, const std::vector<std::string>& extra)
+    {
+        std::string typeIn = std::string("-i:") + c.typeIn;
+        std::string typeOut = std::string("-o:") + c.typeOut;
+        std::vector<std::string> args = { "-w", std::to_string(c.w), "-h", std::to_string(c.h), typeIn, "in",
+            // the output named - keeps the converter from logging, the memory stream does not care about the name
+            typeOut, "-", "-a", std::to_string(c.align), "-r", c.replicate ? "1" : "0", "--threads", std::to_string(c.threads) };
+        if (c.crop)
+        {
+            args.push_back("--crop");
+            args.push_back(std::to_string(c.cropX) + "," + std::to_string(c.cropY) + "," + std::to_string(c.cropW) + "," + std::to_string(c.cropH));
+        }
+        args.insert(args.end(), extra.begin(), extra.end());
+
+        std::vector<const char*> argv;
+        for (const auto& arg : args)
+        {
+            argv.push_back(arg.c_str());
+        }
+        // the converter reports to stderr when writing to "stdout"
+        std::ostringstream log;
+        auto buf = std::cerr.rdbuf(log.rdbuf());
+        converter::FrameConverter<MemoryIStream, MemoryOStream> cvt;
+        int ret = cvt.Execute(static_cast<int>(argv.size()), argv.data());
+        std::cerr.rdbuf(buf);
+
+        return ret;
+    }
+
+    // mayRefuse lets the converter decline a path it cannot take for the case, what it does write must match
+    void Check(const Case& c, const std::vector<char>& expected, size_t frmSz, const std::vector<std::string>& extra,
+               bool mayRefuse = false)
+    {
+        std::string path;
+        for (const auto& arg : extra)
+        {
+            path += " " + arg;
+        }
+        if (Convert(c, extra) != 0)
+        {
+            if (mayRefuse)
+            {
+                return;
+            }
+            std::fprintf(stderr, "%s%s: conversion failed\n", Describe(c).c_str(), path.c_str());
+            std::abort();
+        }
+
+        const auto& actual = g_files["/dev/stdout"];
+        auto mismatch = std::mismatch(expected.begin(), expected.end(), actual.begin(), actual.end());
+        if (mismatch.first != expected.end() || mismatch.second != actual.end())
+        {
+            size_t pos = mismatch.first - expected.begin();
+            std::fprintf(stderr, "%s%s: first mismatch at byte %zu (frame %zu, offset %zu): expected 0x%02x, got ",
+                         Describe(c).c_str(), path.c_str(), pos, pos / frmSz, pos % frmSz,
+                         mismatch.first != expected.end() ? static_cast<uint8_t>(*mismatch.first) : 0);
+            if (mismatch.second != actual.end())
+            {
+                std::fprintf(stderr, "0x%02x\n", static_cast<uint8_t>(*mismatch.second));
+            }
+            else
+            {
+                std::fprintf(stderr, "end of output at %zu bytes\n", actual.size());
+            }
+            std::abort();
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    // 16 bytes of parameters, the rest seeds the pixel data
+    uint8_t p[16] = {0};
+    std::memcpy(p, data, std::min(size, sizeof(p)));
+    static const size_t aligns[] = { 0, 2, 4, 8, 16, 32, 64, 128 };
+
+    Case c;
+    c.typeIn = frame::TYPES[p[0] % TYPE_NUM];
+    c.typeOut = frame::TYPES[p[1] % TYPE_NUM];
+    // even sizes, as every chroma format needs, one in 32 at the size of the reference clips
+    bool big = (p[6] & 0x1f) == 0;
+    c.w = big ? 1918 : 4 + 2 * ((p[2] | p[3] << 8) % 160);
+    c.h = big ? 1078 : 4 + 2 * ((p[4] | p[5] << 8) % 80);
+    c.align = aligns[p[7] & 7];
+    c.replicate = !!(p[7] & 8);
+    c.crop = !!(p[7] & 16);
+    c.cropX = 2 * (p[8] % (c.w / 4));
+    c.cropY = 2 * (p[9] % (c.h / 4));
+    c.cropW = c.w - c.cropX - 2 * (p[10] % (c.w / 4));
+    c.cropH = c.h - c.cropY - 2 * (p[11] % (c.h / 4));
+    c.frames = 1 + p[12] % 3;
+    c.threads = 1 + p[13] % 4;
+    c.stripRows = 2 + 2 * (p[14] % 16);
+
+    std::unique_ptr<frame::Frame> src(frame::Create(c.typeIn, c.w, c.h, "Source"));
+    auto& input = g_files["in"];
+    input.resize(src->FrameSize(false) * c.frames);
+    std::mt19937 rng(static_cast<uint32_t>(size));
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        input[i] = static_cast<char>(rng() ^ (sizeof(p) + i < size ? data[sizeof(p) + i] : 0));
+    }
+
+    frame::Frame::EnableLog(false);
+    size_t slotSz = 0;
+    const auto expected = Reference(c, input, slotSz);
+    const size_t frmSz = expected.size() / c.frames;
+
+    Check(c, expected, frmSz, {});
+    Check(c, expected, frmSz, { "--strip", std::to_string(c.stripRows) });
+    Check(c, expected, frmSz, { "--strip", "auto" });
+    // a second output converts from the same Raw frames while the first is converted
+    Check(c, expected, frmSz, { std::string("-o:") + c.typeIn, "fan" });
+    // the random frames differ, duplicate detection must leave every one converted
+    Check(c, expected, frmSz, { "--dedup", "reuse" });
+    std::unique_ptr<frame::Frame> out(frame::Create(c.typeOut, c.crop ? c.cropW : c.w, c.crop ? c.cropH : c.h, "Output"));
+    out->SetPadding(c.align, c.replicate);
+    // bands need an unpadded output, and a crop of a tiled input that starts on a row of tiles in both planes
+    const bool padded = out->Width(true) != out->Width(false) || out->Height(true) != out->Height(false);
+    if (!padded && (!c.crop || c.cropY % (2 * src->TileRows()) == 0))
+    {
+        // just short of one frame, so every frame is converted in bands; bands of whole rows of tiles may not fit
+        Check(c, expected, frmSz, { "--max-memory", std::to_string(slotSz - 1) }, src->TileRows() > 1 || out->TileRows() > 1);
+    }
+
+    return 0;
+}
+
+#if !defined(DIFFERENTIAL_FUZZ_LIBFUZZER)
+int main(int argc, char** argv)
+{
+    const size_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000;
+    const uint32_t seed = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : std::random_device()();
+    std::printf("differential_fuzz: seed %u\n", seed);
+
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(64);
+    auto run = [&](size_t in, size_t out) {
+        for (auto& byte : data)
+        {
+            byte = static_cast<uint8_t>(rng());
+        }
+        data[0] = static_cast<uint8_t>(in);
+        data[1] = static_cast<uint8_t>(out);
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    };
+
+    for (size_t in = 0; in < TYPE_NUM; in++)
+    {
+        for (size_t out = 0; out < TYPE_NUM; out++)
+        {
+            run(in, out);
+        }
+    }
+    for (size_t i = 0; i < iterations; i++)
+    {
+        run(rng() % TYPE_NUM, rng() % TYPE_NUM);
+    }
+    std::printf("differential_fuzz: %zu format pairs and %zu random cases match\n", TYPE_NUM * TYPE_NUM, iterations);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "frame_selection.hpp"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace affinity
+{
+    // Expands a Linux style cpu list such as "0-7,16-23"
+    inline bool ParseCpus(const char* list, std::vector<int>& cpus)
+    {
+        std::vector<selection::Range> ranges;
+        if (!selection::Parse(list, ranges))
+        {
+            return false;
+        }
+        for (const auto& range : ranges)
+        {
+            if (range.stop == selection::OPEN)
+            {
+                return false;
+            }
+            for (size_t cpu = range.start; cpu < range.stop; cpu++)
+            {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+        }
+
+        return true;
+    }
+
+    // Cpus of every NUMA node, empty when the topology is not exposed
+    inline std::vector<std::vector<int>> Nodes()
+    {
+        std::vector<std::vector<int>> nodes;
+#if defined(__linux__)
+        for (int node = 0;; node++)
+        {
+            auto path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+            FILE* fp = std::fopen(path.c_str(), "r");
+            if (!fp)
+            {
+                break;
+            }
+            char line[4096] = {0};
+            bool ok = std::fgets(line, sizeof(line), fp) != nullptr;
+            std::fclose(fp);
+
+            std::string list(line);
+            list.erase(list.find_last_not_of(" \n") + 1);
+            std::vector<int> cpus;
+            // a memory only node has an empty list
+            if (ok && !list.empty() && ParseCpus(list.c_str(), cpus))
+            {
+                nodes.push_back(cpus);
+            }
+        }
+#endif
+        return nodes;
+    }
+
+    // Bytes of the data or unified cache of the given level seen by cpu 0, 0 when unknown
+    inline size_t CacheSize(int level)
+    {
+        size_t size = 0;
+#if defined(__linux__)
+        for (int index = 0; size == 0; index++)
+        {
+            auto dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+            FILE* fp = std::fopen((dir + "level").c_str(), "r");
+            if (!fp)
+            {
+                break;
+            }
+            int lvl = 0;
+            bool ok = std::fscanf(fp, "%d", &lvl) == 1;
+            std::fclose(fp);
+
+            char type[32] = {0};
+            fp = std::fopen((dir + "type").c_str(), "r");
+            ok = ok && fp && std::fscanf(fp, "%31s", type) == 1;
+            if (fp)
+            {
+                std::fclose(fp);
+            }
+            if (!ok || lvl != level || std::string(type) == "Instruction")
+            {
+                continue;
+            }
+
+            // "2048K"
+            char unit = 0;
+            fp = std::fopen((dir + "size").c_str(), "r");
+            if (fp && std::fscanf(fp, "%zu%c", &size, &unit) >= 1)
+            {
+                size <<= unit == 'K' ? 10 : unit == 'M' ? 20 : 0;
+            }
+            if (fp)
+            {
+                std::fclose(fp);
+            }
+        }
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+        if (size == 0 && level == 2)
+        {
+            long ret = sysconf(_SC_LEVEL2_CACHE_SIZE);
+            size = ret > 0 ? static_cast<size_t>(ret) : 0;
+        }
+#endif
+#else
+        (void)level;
+#endif
+        return size;
+    }
+
+    // Cpus the calling thread may run on, empty where affinity is not supported
+    inline std::vector<int> Current()
+    {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            {
+                if (CPU_ISSET(cpu, &set))
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+#endif
+        return cpus;
+    }
+
+    // Binds the calling thread to cpus, a no-op where affinity is not supported
+    inline bool Pin(const std::vector<int>& cpus)
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+        {
+            CPU_SET(cpu, &set);
+        }
+
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpus;
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace color
+{
+    enum class RANGE
+    {
+        LIMITED = 0,  // luma 16-235, chroma 16-240 at 8 bits
+        FULL    = 1   // every code value
+    };
+
+    enum class MATRIX
+    {
+        BT601  = 0,
+        BT709  = 1,
+        BT2020 = 2   // non-constant luminance
+    };
+
+    // --range in:out and --matrix in:out, what the source was coded with and what the output is coded with
+    struct Spec
+    {
+        RANGE rangeIn = RANGE::LIMITED;
+        RANGE rangeOut = RANGE::LIMITED;
+        MATRIX matrixIn = MATRIX::BT709;
+        MATRIX matrixOut = MATRIX::BT709;
+
+        bool Identity() const
+        {
+            return rangeIn == rangeOut && matrixIn == matrixOut;
+        }
+    };
+
+    // "<in>:<out>" with names[i] naming the value i
+    template <typename T, size_t N>
+    bool ParsePair(const char* arg, const char* const (&names)[N], T& in, T& out)
+    {
+        const char* sep = std::strchr(arg, ':');
+        if (!sep)
+        {
+            return false;
+        }
+        auto find = [&](const std::string& name, T& value) {
+            for (size_t i = 0; i < N; i++)
+            {
+                if (name == names[i])
+                {
+                    value = static_cast<T>(i);
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        return find(std::string(arg, sep), in) && find(std::string(sep + 1), out);
+    }
+
+    inline bool ParseRange(const char* arg, Spec& spec)
+    {
+        static const char* const names[] = { "limited", "full" };
+        return ParsePair(arg, names, spec.rangeIn, spec.rangeOut);
+    }
+
+    inline bool ParseMatrix(const char* arg, Spec& spec)
+    {
+        static const char* const names[] = { "601", "709", "2020" };
+        return ParsePair(arg, names, spec.matrixIn, spec.matrixOut);
+    }
+
+    // Samples are mapped in fixed point with FRAC fractional bits; every product fits 32 bits up to 16-bit
+    // samples, so the loops below vectorize on 32-bit lanes
+    constexpr int FRAC = 14;
+    constexpr int32_t HALF = 1 << (FRAC - 1);
+
+    // Black and the luma span, the chroma zero and the chroma span of a bit depth
+    struct Levels
+    {
+        int32_t black;
+        int32_t luma;
+        int32_t mid;
+        int32_t chroma;
+    };
+
+    constexpr Levels LevelsOf(uint8_t depth, RANGE range)
+    {
+        return range == RANGE::FULL ? Levels{ 0, (1 << depth) - 1, 1 << (depth - 1), (1 << depth) - 1 }
+                                    : Levels{ 16 << (depth - 8), 219 << (depth - 8), 1 << (depth - 1), 224 << (depth - 8) };
+    }
+
+    constexpr double KR[] = { 0.299, 0.2126, 0.2627 };
+    constexpr double KB[] = { 0.114, 0.0722, 0.0593 };
+
+    // y' = y + yu u + yv v, u' = uu u + uv v, v' = vu u + vv v on normalized samples (y in [0, 1], u and v in
+    // [-0.5, 0.5]): the input matrix back to RGB, then the output one. Grey stays grey, so y has weight 1 and
+    // the chroma does not depend on y.
+    struct Mix
+    {
+        double yu;
+        double yv;
+        double uu;
+        double uv;
+        double vu;
+        double vv;
+    };
+
+    constexpr Mix MixOf(MATRIX in, MATRIX out)
+    {
+        const double kr = KR[static_cast<int>(in)];
+        const double kb = KB[static_cast<int>(in)];
+        const double kg = 1 - kr - kb;
+        const double krOut = KR[static_cast<int>(out)];
+        const double kbOut = KB[static_cast<int>(out)];
+        const double kgOut = 1 - krOut - kbOut;
+        // R = y + rv v, G = y - gu u - gv v, B = y + bu u
+        const double rv = 2 * (1 - kr);
+        const double bu = 2 * (1 - kb);
+        const double gu = bu * kb / kg;
+        const double gv = rv * kr / kg;
+        const double yu = kbOut * bu - kgOut * gu;
+        const double yv = krOut * rv - kgOut * gv;
+
+        return { yu, yv, (bu - yu) / (2 * (1 - kbOut)), -yv / (2 * (1 - kbOut)), -yu / (2 * (1 - krOut)), (rv - yv) / (2 * (1 - krOut)) };
+    }
+
+    constexpr int32_t Fixed(double v)
+    {
+        return static_cast<int32_t>(v * (1 << FRAC) + (v < 0 ? -0.5 : 0.5));
+    }
+
+    // The whole mapping from the code values of one depth, range and matrix to those of another
+    struct Coeffs
+    {
+        int32_t blackIn;
+        int32_t midIn;
+        int32_t blackOut;
+        int32_t midOut;
+        int32_t maxOut;
+        int32_t y;
+        int32_t yu;
+        int32_t yv;
+        int32_t uu;
+        int32_t uv;
+        int32_t vu;
+        int32_t vv;
+    };
+
+    constexpr Coeffs CoeffsOf(uint8_t depthIn, uint8_t depthOut, const Spec& spec)
+    {
+        const Levels in = LevelsOf(depthIn, spec.rangeIn);
+        const Levels out = LevelsOf(depthOut, spec.rangeOut);
+        const Mix mix = MixOf(spec.matrixIn, spec.matrixOut);
+        const double luma = static_cast<double>(out.luma);
+        const double chroma = static_cast<double>(out.chroma);
+
+        return { in.black, in.mid, out.black, out.mid, (1 << depthOut) - 1,
+                 Fixed(luma / in.luma), Fixed(luma * mix.yu / in.chroma), Fixed(luma * mix.yv / in.chroma),
+                 Fixed(chroma * mix.uu / in.chroma), Fixed(chroma * mix.uv / in.chroma),
+                 Fixed(chroma * mix.vu / in.chroma), Fixed(chroma * mix.vv / in.chroma) };
+    }
+
+    constexpr uint16_t Clamp(int32_t v, int32_t max)
+    {
+        return static_cast<uint16_t>(v < 0 ? 0 : (v > max ? max : v));
+    }
+
+    constexpr uint16_t Luma(const Coeffs& c, int32_t y, int32_t u, int32_t v)
+    {
+        return Clamp(c.blackOut + ((c.y * (y - c.blackIn) + c.yu * (u - c.midIn) + c.yv * (v - c.midIn) + HALF) >> FRAC), c.maxOut);
+    }
+
+    constexpr uint16_t Cb(const Coeffs& c, int32_t u, int32_t v)
+    {
+        return Clamp(c.midOut + ((c.uu * (u - c.midIn) + c.uv * (v - c.midIn) + HALF) >> FRAC), c.maxOut);
+    }
+
+    constexpr uint16_t Cr(const Coeffs& c, int32_t u, int32_t v)
+    {
+        return Clamp(c.midOut + ((c.vu * (u - c.midIn) + c.vv * (v - c.midIn) + HALF) >> FRAC), c.maxOut);
+    }
+
+    // Luma and chroma of a range change, indexed by the source code value
+    struct Lut
+    {
+        const uint16_t* luma = nullptr;
+        const uint16_t* chroma = nullptr;
+    };
+
+    // A range change alone maps every sample on its own, from 8 and 10-bit sources through tables built at
+    // compile time
+    template <uint8_t DEPTH_IN, uint8_t DEPTH_OUT, RANGE IN, RANGE OUT>
+    struct Table
+    {
+        using Samples = std::array<uint16_t, size_t(1) << DEPTH_IN>;
+
+        static constexpr Spec spec = { IN, OUT, MATRIX::BT709, MATRIX::BT709 };
+
+        static constexpr Samples Make(bool chroma)
+        {
+            constexpr Coeffs c = CoeffsOf(DEPTH_IN, DEPTH_OUT, spec);
+            Samples samples{};
+            for (size_t i = 0; i < samples.size(); i++)
+            {
+                samples[i] = chroma ? Cb(c, static_cast<int32_t>(i), c.midIn) : Luma(c, static_cast<int32_t>(i), c.midIn, c.midIn);
+            }
+            return samples;
+        }
+
+        static constexpr Samples luma = Make(false);
+        static constexpr Samples chroma = Make(true);
+    };
+
+    template <uint8_t DEPTH_IN, RANGE IN, RANGE OUT>
+    Lut LutOf(uint8_t depthOut)
+    {
+        switch (depthOut)
+        {
+        case 8:
+            return { Table<DEPTH_IN, 8, IN, OUT>::luma.data(), Table<DEPTH_IN, 8, IN, OUT>::chroma.data() };
+        case 10:
+            return { Table<DEPTH_IN, 10, IN, OUT>::luma.data(), Table<DEPTH_IN, 10, IN, OUT>::chroma.data() };
+        case 12:
+            return { Table<DEPTH_IN, 12, IN, OUT>::luma.data(), Table<DEPTH_IN, 12, IN, OUT>::chroma.data() };
+        case 16:
+            return { Table<DEPTH_IN, 16, IN, OUT>::luma.data(), Table<DEPTH_IN, 16, IN, OUT>::chroma.data() };
+        default:
+            return {};
+        }
+    }
+
+    // No tables for a matrix change or other source depths
+    inline Lut LutOf(uint8_t depthIn, uint8_t depthOut, const Spec& spec)
+    {
+        if (spec.matrixIn != spec.matrixOut || spec.rangeIn == spec.rangeOut)
+        {
+            return {};
+        }
+        const bool full = spec.rangeOut == RANGE::FULL;
+        switch (depthIn)
+        {
+        case 8:
+            return full ? LutOf<8, RANGE::LIMITED, RANGE::FULL>(depthOut) : LutOf<8, RANGE::FULL, RANGE::LIMITED>(depthOut);
+        case 10:
+            return full ? LutOf<10, RANGE::LIMITED, RANGE::FULL>(depthOut) : LutOf<10, RANGE::FULL, RANGE::LIMITED>(depthOut);
+        default:
+            return {};
+        }
+    }
+
+    // Converts the samples of a frame from the depth, range and matrix of its source to those of the output
+    class Transform
+    {
+    public:
+        Transform(const Spec& spec, uint8_t depthIn, uint8_t depthOut)
+            : m_c(CoeffsOf(depthIn, depthOut, spec)), m_lut(LutOf(depthIn, depthOut, spec)),
+              m_maxIn(static_cast<uint16_t>((1 << depthIn) - 1)), m_mix(spec.matrixIn != spec.matrixOut)
+        {
+        }
+
+        // n luma samples, u and v the chroma rows they sit on (every 2nd sample with subsampled), null for grey;
+        // out may be y
+        template <bool SUBSAMPLED>
+        void Luma(const uint16_t* y, const uint16_t* u, const uint16_t* v, uint16_t* out, size_t n) const
+        {
+            if (m_lut.luma)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    out[i] = m_lut.luma[std::min(y[i], m_maxIn)];
+                }
+                return;
+            }
+            if (!m_mix || !u)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    out[i] = color::Luma(m_c, y[i], m_c.midIn, m_c.midIn);
+                }
+                return;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                const size_t j = SUBSAMPLED ? i / 2 : i;
+                out[i] = color::Luma(m_c, y[i], u[j], v[j]);
+            }
+        }
+
+        // n chroma samples, outU and outV may be u and v
+        void Chroma(const uint16_t* u, const uint16_t* v, uint16_t* outU, uint16_t* outV, size_t n) const
+        {
+            if (m_lut.chroma)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    outU[i] = m_lut.chroma[std::min(u[i], m_maxIn)];
+                    outV[i] = m_lut.chroma[std::min(v[i], m_maxIn)];
+                }
+                return;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                const int32_t cb = u[i];
+                const int32_t cr = v[i];
+                outU[i] = Cb(m_c, cb, cr);
+                outV[i] = Cr(m_c, cb, cr);
+            }
+        }
+
+    private:
+        const Coeffs m_c;
+        const Lut m_lut;
+        const uint16_t m_maxIn;
+        const bool m_mix;
+    };
+}
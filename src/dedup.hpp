@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace dedup
+{
+    // What happens to a frame that repeats the last converted one
+    enum class MODE
+    {
+        OFF,
+        DROP,
+        REUSE
+    };
+
+    inline uint64_t Rotl(uint64_t v, int r)
+    {
+        return (v << r) | (v >> (64 - r));
+    }
+
+    // 64-bit hash of the packed frame bytes, only good for spotting repeats. Four independent lanes take 32
+    // bytes per step, so the loop has no dependency between them and the compiler can keep them in vector
+    // registers; the frame is touched once at memory speed.
+    inline uint64_t Hash(const char* data, size_t size)
+    {
+        constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr size_t LANES = 4;
+        constexpr size_t BLOCK = LANES * sizeof(uint64_t);
+
+        uint64_t lane[LANES] = { P1 + P2, P2, 0, ~P1 };
+        auto step = [&](const char* p) {
+            for (size_t l = 0; l < LANES; l++)
+            {
+                uint64_t v;
+                std::memcpy(&v, p + l * sizeof(v), sizeof(v));
+                lane[l] = Rotl(lane[l] + v * P2, 31) * P1;
+            }
+        };
+
+        size_t blocks = size / BLOCK;
+        for (size_t b = 0; b < blocks; b++)
+        {
+            step(data + b * BLOCK);
+        }
+        if (size % BLOCK != 0)
+        {
+            char tail[BLOCK] = {0};
+            std::memcpy(tail, data + blocks * BLOCK, size % BLOCK);
+            step(tail);
+        }
+
+        uint64_t h = size * P1;
+        for (size_t l = 0; l < LANES; l++)
+        {
+            h = Rotl(h ^ Rotl(lane[l] * P2, 31) * P1, 27) * P1 + P2;
+        }
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+
+        return h;
+    }
+
+    // How the samples sit in the packed frame: little endian words of `bytes` bytes, each holding `count`
+    // samples of `bits` bits, the first one `shift` bits up and the others right above it
+    struct Samples
+    {
+        size_t bytes = 1;
+        size_t count = 1;
+        uint8_t shift = 0;
+        uint8_t bits = 8;
+    };
+
+    // Sum of the absolute sample differences over n words
+    template <typename word_t>
+    inline uint64_t Distance(const char* a, const char* b, size_t n, const Samples& samples)
+    {
+        const uint32_t mask = (1u << samples.bits) - 1;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            word_t wa, wb;
+            std::memcpy(&wa, a + i * sizeof(word_t), sizeof(word_t));
+            std::memcpy(&wb, b + i * sizeof(word_t), sizeof(word_t));
+            uint32_t x = static_cast<uint32_t>(wa) >> samples.shift;
+            uint32_t y = static_cast<uint32_t>(wb) >> samples.shift;
+            for (size_t c = 0; c < samples.count; c++)
+            {
+                const uint32_t p = x & mask;
+                const uint32_t q = y & mask;
+                sum += p > q ? p - q : q - p;
+                x >>= samples.bits;
+                y >>= samples.bits;
+            }
+        }
+
+        return sum;
+    }
+
+    // true when the mean absolute difference of the samples is at most threshold, in units of the sample
+    // depth. The sum is checked after every block, so frames that clearly differ stop early.
+    inline bool Similar(const char* a, const char* b, size_t size, double threshold, const Samples& samples = {})
+    {
+        constexpr size_t BLOCK = 4096;
+        const size_t words = size / samples.bytes;
+        const size_t step = BLOCK / samples.bytes;
+        const double limit = threshold * words * samples.count;
+        uint64_t total = 0;
+        for (size_t w = 0; w < words; w += step)
+        {
+            const size_t n = w + step < words ? step : words - w;
+            const char* pa = a + w * samples.bytes;
+            const char* pb = b + w * samples.bytes;
+            switch (samples.bytes)
+            {
+            case 1:
+                total += Distance<uint8_t>(pa, pb, n, samples);
+                break;
+            case 2:
+                total += Distance<uint16_t>(pa, pb, n, samples);
+                break;
+            default:
+                total += Distance<uint32_t>(pa, pb, n, samples);
+                break;
+            }
+            if (total > limit)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include "picosha2.h"
+
+namespace digest
+{
+    using Sha256 = picosha2::hash256_one_by_one;
+
+    // picosha2 copies its input into an internal buffer, feed it in cache sized pieces
+    inline void Update(Sha256& hasher, const char* data, size_t size)
+    {
+        constexpr size_t chunk = 64 * 1024;
+        for (size_t off = 0; off < size; off += chunk)
+        {
+            hasher.process(data + off, data + std::min(size, off + chunk));
+        }
+    }
+
+    inline std::string Final(Sha256& hasher)
+    {
+        hasher.finish();
+
+        return picosha2::get_hash_hex_string(hasher);
+    }
+
+    inline std::string Of(const char* data, size_t size)
+    {
+        Sha256 hasher;
+        Update(hasher, data, size);
+
+        return Final(hasher);
+    }
+}
@@ -0,0 +1,489 @@
+#pragma once
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ios>
+#include <memory>
+#include <string>
+
+namespace io
+{
+    // Unbuffered POSIX file with the subset of the std::fstream interface used by the converter. A regular file
+    // is accessed with pread/pwrite at a tracked offset, so seekg costs nothing and only the requested bytes are
+    // read; pipes fall back to read/write and cannot seek.
+    //
+    // In direct mode the file is opened with O_DIRECT (F_NOCACHE on macOS) so large sequences bypass the page
+    // cache. Transfers then go through a sector aligned bounce buffer of several frames: reads are widened to
+    // aligned blocks and copied out, writes are staged and flushed in aligned blocks, and the unaligned tail of
+    // the output is written with O_DIRECT cleared on close or seekp. Filesystems without O_DIRECT get the buffered
+    // path.
+    //
+    // The buffered path steers the page cache for long sequential jobs: inputs are opened for sequential access
+    // and a read that continues the previous one asks for the same amount after it (the next batch), writes
+    // start writeback every WRITE_BEHIND bytes so dirty pages do not pile up. With DropCache the pages of
+    // what was read, and of what was written once it reached the disk, are dropped.
+    class File
+    {
+    public:
+        explicit File(bool direct = false) : m_direct(direct) {}
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        // Drop the page cache behind the buffered reads and writes, for jobs larger than memory
+        static void DropCache(bool en)
+        {
+            _dropCache = en;
+        }
+
+        ~File()
+        {
+            close();
+        }
+
+        void open(const std::string& filename, std::ios_base::openmode mode)
+        {
+            close();
+            m_out = !!(mode & std::ios_base::out);
+            // in | out updates an existing file in place, as std::fstream does
+            int flags = (m_out ? O_WRONLY | O_CREAT | (mode & std::ios_base::in ? 0 : O_TRUNC) : O_RDONLY) | O_CLOEXEC;
+            m_fd = -1;
+            m_directOn = false;
+#if defined(O_DIRECT)
+            if (m_direct)
+            {
+                m_fd = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+                m_directOn = m_fd >= 0;
+            }
+#endif
+            if (m_fd < 0)
+            {
+                m_fd = ::open(filename.c_str(), flags, 0644);
+            }
+            m_seekable = m_fd >= 0 && ::lseek(m_fd, 0, SEEK_CUR) >= 0;
+            m_pos = 0;
+            m_flushPos = 0;
+            m_staged = 0;
+            m_good = m_fd >= 0;
+            m_readEnd = 0;
+            m_wbPrev = m_wbPos = m_wbEnd = 0;
+            if (m_good && m_seekable && !m_out && !m_directOn)
+            {
+                Advise(0, 0, ADVICE_SEQUENTIAL);
+            }
+
+            if (m_good && m_directOn && !m_seekable)
+            {
+                // a pipe has no cache to bypass
+                SetDirect(false);
+            }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+            else if (m_good && m_direct)
+            {
+                // no alignment rules, the bounce buffer is not needed
+                ::fcntl(m_fd, F_NOCACHE, 1);
+            }
+#endif
+            if (m_directOn && !m_bounce)
+            {
+                void* p = nullptr;
+                if (posix_memalign(&p, SECTOR, BOUNCE_SIZE) == 0)
+                {
+                    m_bounce.reset(static_cast<char*>(p));
+                }
+                else
+                {
+                    SetDirect(false);
+                }
+            }
+        }
+
+        void close()
+        {
+            if (m_fd >= 0)
+            {
+                Drain();
+                ::close(m_fd);
+                m_fd = -1;
+            }
+            m_good = false;
+        }
+
+        File& read(char* s, std::streamsize n)
+        {
+            const off_t start = m_pos;
+            m_gcount = 0;
+            while (m_good && m_gcount < n)
+            {
+                if (m_directOn)
+                {
+                    ReadDirect(s + m_gcount, n - m_gcount);
+                    continue;
+                }
+                auto ret = m_seekable ? ::pread(m_fd, s + m_gcount, n - m_gcount, m_pos) : ::read(m_fd, s + m_gcount, n - m_gcount);
+                if (ret < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (ret <= 0)
+                {
+                    // short read at the end of the stream, as std::istream sets eof and fail
+                    m_good = false;
+                    break;
+                }
+                m_gcount += ret;
+                m_pos += ret;
+            }
+            if (m_seekable && !m_directOn && m_gcount > 0)
+            {
+                AfterRead(start, m_gcount);
+            }
+
+            return *this;
+        }
+
+        File& write(const char* s, std::streamsize n)
+        {
+            if (m_directOn)
+            {
+                for (std::streamsize done = 0; m_good && done < n;)
+                {
+                    size_t size = std::min(static_cast<size_t>(n - done), BOUNCE_SIZE - m_staged);
+                    std::memcpy(m_bounce.get() + m_staged, s + done, size);
+                    m_staged += size;
+                    done += size;
+                    if (m_staged == BOUNCE_SIZE)
+                    {
+                        Flush(m_staged);
+                    }
+                }
+                m_pos += n;
+                return *this;
+            }
+
+            const off_t start = m_pos;
+            std::streamsize done = 0;
+            while (m_good && done < n)
+            {
+                auto ret = m_seekable ? ::pwrite(m_fd, s + done, n - done, m_pos) : ::write(m_fd, s + done, n - done);
+                if (ret < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (ret <= 0)
+                {
+                    m_good = false;
+                    break;
+                }
+                done += ret;
+                m_pos += ret;
+            }
+            if (m_seekable && done > 0)
+            {
+                AfterWrite(start, done);
+            }
+
+            return *this;
+        }
+
+        // What is staged is written out first. Direct mode then stages again from pos when it is sector aligned,
+        // an unaligned pos is written through the page cache until a seek lands on a sector again.
+        File& seekp(std::streampos pos)
+        {
+            Drain();
+            m_pos = pos;
+            m_good = m_good && m_seekable;
+            const bool aligned = (m_pos & static_cast<off_t>(SECTOR - 1)) == 0;
+            if (m_good && m_out && m_bounce && m_directOn != aligned)
+            {
+                SetDirect(aligned);
+            }
+            m_flushPos = m_pos;
+
+            return *this;
+        }
+
+        File& seekg(std::streampos pos)
+        {
+            return seekg(static_cast<std::streamoff>(pos), std::ios_base::beg);
+        }
+
+        File& seekg(std::streamoff off, std::ios_base::seekdir dir)
+        {
+            if (!m_good || !m_seekable)
+            {
+                m_good = false;
+                return *this;
+            }
+
+            if (dir == std::ios_base::end)
+            {
+                struct stat st;
+                m_good = ::fstat(m_fd, &st) == 0;
+                off += st.st_size;
+            }
+            else if (dir == std::ios_base::cur)
+            {
+                off += m_pos;
+            }
+            m_pos = off;
+
+            return *this;
+        }
+
+        std::streampos tellg() const
+        {
+            return m_good && m_seekable ? std::streampos(m_pos) : std::streampos(-1);
+        }
+
+        std::streamsize gcount() const
+        {
+            return m_gcount;
+        }
+
+        void clear()
+        {
+            m_good = m_fd >= 0;
+        }
+
+        operator bool() const
+        {
+            return m_good;
+        }
+
+    private:
+        static constexpr size_t SECTOR = 4096;
+        static constexpr size_t BOUNCE_SIZE = 16 << 20;
+        static constexpr off_t WRITE_BEHIND = 32 << 20;
+#if defined(POSIX_FADV_SEQUENTIAL)
+        static constexpr int ADVICE_SEQUENTIAL = POSIX_FADV_SEQUENTIAL;
+        static constexpr int ADVICE_WILLNEED = POSIX_FADV_WILLNEED;
+        static constexpr int ADVICE_DONTNEED = POSIX_FADV_DONTNEED;
+#else
+        static constexpr int ADVICE_SEQUENTIAL = 0;
+        static constexpr int ADVICE_WILLNEED = 0;
+        static constexpr int ADVICE_DONTNEED = 0;
+#endif
+
+        // Hints only, a filesystem that ignores them or a system without posix_fadvise changes nothing
+        void Advise(off_t off, off_t len, int advice) const
+        {
+#if defined(POSIX_FADV_SEQUENTIAL)
+            ::posix_fadvise(m_fd, off, len, advice);
+#else
+            (void)off;
+            (void)len;
+            (void)advice;
+#endif
+        }
+
+        // The converter reads a batch in one call, a read continuing the last one is a stream and the next
+        // batch is as large. What was read is in the caller's buffer, its pages are not needed again.
+        void AfterRead(off_t start, off_t size)
+        {
+            if (start == m_readEnd)
+            {
+                Advise(start + size, size, ADVICE_WILLNEED);
+            }
+            if (_dropCache)
+            {
+                Advise(start, size, ADVICE_DONTNEED);
+            }
+            m_readEnd = start + size;
+        }
+
+        // Once WRITE_BEHIND bytes follow the last chunk handed to writeback they are handed over too. The chunk
+        // before it had a whole chunk of writes to reach the disk, with DropCache it is waited for and dropped.
+        void AfterWrite(off_t start, off_t size)
+        {
+#if defined(__linux__)
+            if (start != m_wbEnd)
+            {
+                // a seek starts a new stream
+                m_wbPrev = m_wbPos = start;
+            }
+            m_wbEnd = start + size;
+            if (m_wbEnd - m_wbPos < WRITE_BEHIND)
+            {
+                return;
+            }
+
+            ::sync_file_range(m_fd, m_wbPos, m_wbEnd - m_wbPos, SYNC_FILE_RANGE_WRITE);
+            if (_dropCache && m_wbPrev < m_wbPos)
+            {
+                ::sync_file_range(m_fd, m_wbPrev, m_wbPos - m_wbPrev,
+                                  SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+                Advise(m_wbPrev, m_wbPos - m_wbPrev, ADVICE_DONTNEED);
+            }
+            m_wbPrev = m_wbPos;
+            m_wbPos = m_wbEnd;
+#else
+            (void)start;
+            (void)size;
+#endif
+        }
+
+        // One aligned request covering as much of [m_pos, m_pos + n) as the bounce buffer holds
+        void ReadDirect(char* s, std::streamsize n)
+        {
+            off_t start = m_pos & ~static_cast<off_t>(SECTOR - 1);
+            size_t head = static_cast<size_t>(m_pos - start);
+            size_t want = std::min((head + n + SECTOR - 1) & ~(SECTOR - 1), BOUNCE_SIZE);
+            ssize_t ret;
+            while ((ret = ::pread(m_fd, m_bounce.get(), want, start)) < 0 && errno == EINTR)
+            {
+            }
+            if (ret <= static_cast<ssize_t>(head))
+            {
+                m_good = false;
+                return;
+            }
+            size_t got = std::min(static_cast<size_t>(ret) - head, static_cast<size_t>(n));
+            std::memcpy(s, m_bounce.get() + head, got);
+            m_gcount += got;
+            m_pos += got;
+        }
+
+        // Writes out what is staged, an unaligned tail with O_DIRECT cleared
+        void Drain()
+        {
+            if (m_out && m_directOn)
+            {
+                size_t aligned = m_staged & ~(SECTOR - 1);
+                size_t tail = m_staged - aligned;
+                Flush(aligned);
+                if (tail != 0)
+                {
+                    std::memmove(m_bounce.get(), m_bounce.get() + aligned, tail);
+                    SetDirect(false);
+                    Flush(tail);
+                }
+            }
+        }
+
+        void Flush(size_t size)
+        {
+            for (size_t done = 0; m_good && done < size;)
+            {
+                auto ret = ::pwrite(m_fd, m_bounce.get() + done, size - done, m_flushPos);
+                if (ret < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (ret <= 0)
+                {
+                    m_good = false;
+                    break;
+                }
+                done += ret;
+                m_flushPos += ret;
+            }
+            m_staged = 0;
+        }
+
+        void SetDirect(bool on)
+        {
+#if defined(O_DIRECT)
+            int flags = ::fcntl(m_fd, F_GETFL);
+            ::fcntl(m_fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT);
+            m_directOn = on;
+#else
+            (void)on;
+#endif
+        }
+
+    protected:
+        int m_fd = -1;
+        bool m_direct = false;
+        bool m_directOn = false;
+        bool m_out = false;
+        bool m_seekable = false;
+        bool m_good = false;
+        off_t m_pos = 0;
+        off_t m_flushPos = 0;
+        off_t m_readEnd = -1;
+        off_t m_wbPrev = 0;
+        off_t m_wbPos = 0;
+        off_t m_wbEnd = 0;
+        size_t m_staged = 0;
+        std::streamsize m_gcount = 0;
+        std::unique_ptr<char, decltype(&free)> m_bounce{nullptr, &free};
+        static inline bool _dropCache = false;
+    };
+
+    // Copies size bytes from one file to another by offset. copy_file_range keeps the data in the kernel (and
+    // lets filesystems that support it share the extents); elsewhere, or across filesystems where it fails,
+    // the bytes go through pread/pwrite. false when the input cannot be opened or ends early.
+    inline bool CopyRange(const std::string& from, off_t offIn, const std::string& to, off_t offOut, size_t size)
+    {
+        int in = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0)
+        {
+            return false;
+        }
+        int out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        bool ok = out >= 0;
+#if defined(__linux__)
+        while (ok && size > 0)
+        {
+            auto ret = ::copy_file_range(in, &offIn, out, &offOut, size, 0);
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ret <= 0)
+            {
+                break;
+            }
+            size -= ret;
+        }
+#endif
+        constexpr size_t PIECE = 1 << 20;
+        std::unique_ptr<char[]> buf(size > 0 ? new char[std::min(size, PIECE)] : nullptr);
+        while (ok && size > 0)
+        {
+            auto ret = ::pread(in, buf.get(), std::min(size, PIECE), offIn);
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            ok = ret > 0;
+            for (ssize_t done = 0; ok && done < ret;)
+            {
+                auto put = ::pwrite(out, buf.get() + done, ret - done, offOut + done);
+                if (put < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                ok = put > 0;
+                done += put;
+            }
+            offIn += ret;
+            offOut += ret;
+            size -= ok ? ret : 0;
+        }
+
+        ::close(in);
+        if (out >= 0)
+        {
+            ::close(out);
+        }
+
+        return ok;
+    }
+
+    // File opened for direct I/O, the converter streams are chosen by type
+    class DirectFile final : public File
+    {
+    public:
+        DirectFile() : File(true) {}
+    };
+}
+
+#endif
@@ -25,6 +25,7 @@ enum class FOURCC
     UYVY        = MAKEFOURCC('U', 'Y', 'V', 'Y'),
     Y210        = MAKEFOURCC('Y', '2', '1', '0'),
     Y216        = MAKEFOURCC('Y', '2', '1', '6'),
+    V210        = MAKEFOURCC('v', '2', '1', '0'),
 
     // YUV 444
     I440        = MAKEFOURCC('I', '4', '4', '0'),
@@ -34,6 +35,7 @@ enum class FOURCC
     VUYX        = MAKEFOURCC('V', 'U', 'Y', 'X'),  // AYUV
     Y410        = MAKEFOURCC('Y', '4', '1', '0'),
     Y416        = MAKEFOURCC('Y', '4', '1', '6'),
+    V410        = MAKEFOURCC('v', '4', '1', '0'),
     NV24        = MAKEFOURCC('N', 'V', '2', '4'),
     P410        = MAKEFOURCC('P', '4', '1', '0'),
     P416        = MAKEFOURCC('P', '4', '1', '6'),
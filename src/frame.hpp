@@ -1,11 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 #include "chroma_format.h"
+#include "color.hpp"
+#include "scaler.hpp"
 
 #define CREATE_FRAME(fourcc, width, height, name) \
   new fourcc(width, height, name)
@@ -16,7 +22,7 @@ namespace frame
 {
     class Frame
     {
-    protected:
+    public:
         struct Raw
         {
             using value_t = uint16_t;
@@ -34,7 +40,33 @@ namespace frame
         }
 
     public:
-        Frame(size_t w, size_t h, const std::string &name = "") : m_w(w), m_h(h), m_wPadded(w), m_hPadded(h), m_name(name) {}
+        Frame(size_t w, size_t h, const std::string &name = "") : m_w(w), m_h(h), m_wPadded(w), m_hPadded(h), m_srcW(w), m_srcH(h), m_name(name) {}
+
+        // Makes the frame a x, y window of srcW x srcH source frames, ReadFrame then unpacks only the window
+        void SetCrop(size_t srcW, size_t srcH, size_t x, size_t y)
+        {
+            size_t alignX = WidthChromaOf(2) == 1 ? 2 : 1;
+            size_t alignY = HeightChromaOf(2) == 1 ? 2 : 1;
+            if (x + m_w > srcW || y + m_h > srcH || x % alignX != 0 || m_w % alignX != 0 || y % alignY != 0 || m_h % alignY != 0)
+            {
+                std::invalid_argument e("The crop window must be inside the frame and aligned to the chroma samples!");
+                throw e;
+            }
+
+            m_srcW = srcW;
+            m_srcH = srcH;
+            m_x0 = x;
+            m_y0 = y;
+        }
+
+        // Byte ranges [first, second) of a source frame holding the rows of the crop window, in file order
+        virtual std::vector<std::pair<size_t, size_t>> CropRanges() const = 0;
+
+        // Rows of a plane stored together, a window of whole tile rows is a frame of its own
+        virtual size_t TileRows() const
+        {
+            return 1;
+        }
 
         void SetPadding(size_t align, bool replicate)
         {
@@ -66,7 +98,49 @@ namespace frame
             }
         }
 
+        // Range and matrix the output samples are converted to, from those the source is taken to have
+        void SetColor(const color::Spec& spec)
+        {
+            m_color = spec;
+        }
+
         void ConvertFrom(const Frame& frame)
+        {
+            Convert(frame, false, false, false);
+        }
+
+        // Converts like ConvertFrom, but the planes needing no change (same bit depth and no range or matrix
+        // change, and same chroma format for U and V) are swapped with those of frame instead of copied, a repack such as NV12 to I420 then costs
+        // only the unpack and the pack. frame keeps planes of its own sizes, fit for its next ReadFrame, holding
+        // what this frame had. The planes are copied the first time, while this frame's are not allocated yet.
+        void MoveFrom(Frame& frame)
+        {
+            CheckSize(frame);
+
+            bool depth = GetBitDepth() == frame.GetBitDepth() && m_color.Identity();
+            bool moveA = HasAChannel() && !frame.m_raw.A.empty() && m_raw.A.size() == frame.m_raw.A.size();
+            bool moveY = depth && m_raw.Y.size() == frame.m_raw.Y.size();
+            bool moveUV = depth && GetChromaFmt() == frame.GetChromaFmt() && GetChromaFmt() != CHROMA_FORMAT::YUV_400 &&
+                          m_raw.U.size() == frame.m_raw.U.size() && m_raw.V.size() == frame.m_raw.V.size();
+            if (moveA)
+            {
+                m_raw.A.swap(frame.m_raw.A);
+            }
+            if (moveY)
+            {
+                m_raw.Y.swap(frame.m_raw.Y);
+            }
+            if (moveUV)
+            {
+                m_raw.U.swap(frame.m_raw.U);
+                m_raw.V.swap(frame.m_raw.V);
+            }
+
+            Convert(frame, moveA, moveY, moveUV);
+        }
+
+    protected:
+        void CheckSize(const Frame& frame) const
         {
             if (m_w != frame.m_w || m_wPadded != frame.m_wPadded ||
                 m_h != frame.m_h || m_hPadded != frame.m_hPadded)
@@ -74,6 +148,12 @@ namespace frame
                 std::invalid_argument e("Incompatible frame type!");
                 throw e;
             }
+        }
+
+        // The planes already moved from frame are left alone, frame holds other data in their place
+        void Convert(const Frame& frame, bool movedA, bool movedY, bool movedUV)
+        {
+            CheckSize(frame);
 
             auto depthSrc = frame.GetBitDepth();
             auto depthTarget = GetBitDepth();
@@ -86,7 +166,7 @@ namespace frame
                 {
                     m_raw.A.resize(frame.m_raw.Y.size(), 0);
                 }
-                else
+                else if (!movedA)
                 {
                     m_raw.A = frame.m_raw.A;
                 }
@@ -96,13 +176,15 @@ namespace frame
                 m_raw.A.clear();
             }
 
+            // a range or matrix change maps the samples from the source depth once the chroma is resampled
+            const bool recolor = !m_color.Identity();
             bool rShift = depthSrc > depthTarget;
-            auto shift = rShift ? depthSrc - depthTarget : depthTarget - depthSrc;
+            auto shift = recolor ? 0 : (rShift ? depthSrc - depthTarget : depthTarget - depthSrc);
 
 #define GET_SRC_PIXEL(PLANE, idx) (rShift ? frame.m_raw.PLANE[idx] >> shift : frame.m_raw.PLANE[idx] << shift)
 
             m_raw.Y.resize(frame.m_raw.Y.size());
-            for (size_t i = 0; i < m_raw.Y.size(); i++)
+            for (size_t i = 0; i < m_raw.Y.size() && !movedY && !recolor; i++)
             {
                 m_raw.Y[i] = GET_SRC_PIXEL(Y, i);
             }
@@ -116,11 +198,15 @@ namespace frame
             m_raw.V.resize(pixelChroma / 2, uvDefault);
             if (chromaFmtSrc == CHROMA_FORMAT::YUV_400 || chromaFmtTarget == CHROMA_FORMAT::YUV_400)
             {
+                if (recolor)
+                {
+                    Recolor(frame);
+                }
                 return;
             }
             else if (chromaFmtSrc == chromaFmtTarget)
             {
-                for (size_t i = 0; i < m_raw.U.size(); i++)
+                for (size_t i = 0; i < m_raw.U.size() && !movedUV && !recolor; i++)
                 {
                     m_raw.U[i] = GET_SRC_PIXEL(U, i);
                     m_raw.V[i] = GET_SRC_PIXEL(V, i);
@@ -309,9 +395,139 @@ namespace frame
                 // cannot be here
             }
 
+            if (recolor)
+            {
+                Recolor(frame);
+            }
+
 #undef GET_SRC_PIXEL
         }
 
+        // Maps the samples to the depth, range and matrix of this frame in one pass over the planes, padding
+        // included: luma, and chroma of the same format, straight from frame, resampled chroma in place. Luma is
+        // done first, a matrix change mixes in the chroma it sits on.
+        void Recolor(const Frame& frame)
+        {
+            color::Transform transform(m_color, frame.GetBitDepth(), GetBitDepth());
+            const bool chroma = GetChromaFmt() != CHROMA_FORMAT::YUV_400 && frame.GetChromaFmt() != CHROMA_FORMAT::YUV_400;
+            const Frame& chromaSrc = GetChromaFmt() == frame.GetChromaFmt() ? frame : *this;
+            const Raw::value_t* srcU = chroma ? chromaSrc.m_raw.U.data() : nullptr;
+            const Raw::value_t* srcV = chroma ? chromaSrc.m_raw.V.data() : nullptr;
+            const size_t widthChromaPadded = WidthChroma(true);
+            const bool subX = WidthChromaOf(2) == 1;
+            const size_t shiftY = HeightChromaOf(2) == 1 ? 1 : 0;
+
+            for (size_t h = 0; h < m_hPadded; h++)
+            {
+                const auto* y = &frame.m_raw.Y[h * m_wPadded];
+                auto* out = &m_raw.Y[h * m_wPadded];
+                const auto* u = chroma ? srcU + (h >> shiftY) * widthChromaPadded : nullptr;
+                const auto* v = chroma ? srcV + (h >> shiftY) * widthChromaPadded : nullptr;
+                if (subX)
+                {
+                    transform.Luma<true>(y, u, v, out, m_wPadded);
+                }
+                else
+                {
+                    transform.Luma<false>(y, u, v, out, m_wPadded);
+                }
+            }
+            if (chroma)
+            {
+                transform.Chroma(srcU, srcV, m_raw.U.data(), m_raw.V.data(), m_raw.U.size());
+            }
+        }
+
+    public:
+        // Puts the rows of field, a frame of this format at half the height, on rows parity, parity + 2, ... of
+        // every plane. Interlaced 4:2:0 chroma is sampled per field, so chroma rows alternate the same way.
+        void WeaveFrom(const Frame& field, size_t parity)
+        {
+            if (GetChromaFmt() != field.GetChromaFmt() || GetBitDepth() != field.GetBitDepth() ||
+                HasAChannel() != field.HasAChannel() || m_w != field.m_w || m_h != field.m_h * 2 ||
+                HeightChroma(false) != field.HeightChroma(false) * 2 || parity > 1)
+            {
+                std::invalid_argument e("Incompatible frame type!");
+                throw e;
+            }
+
+            auto weave = [parity](const std::vector<Raw::value_t>& src, size_t srcStride, std::vector<Raw::value_t>& dst,
+                                  size_t dstStride, size_t width, size_t rows) {
+                for (size_t h = 0; h < rows; h++)
+                {
+                    std::copy_n(&src[h * srcStride], width, &dst[(2 * h + parity) * dstStride]);
+                }
+            };
+            if (HasAChannel() && !field.m_raw.A.empty())
+            {
+                weave(field.m_raw.A, field.m_wPadded, m_raw.A, m_wPadded, m_w, field.m_h);
+            }
+            weave(field.m_raw.Y, field.m_wPadded, m_raw.Y, m_wPadded, m_w, field.m_h);
+            if (GetChromaFmt() != CHROMA_FORMAT::YUV_400)
+            {
+                weave(field.m_raw.U, field.WidthChroma(true), m_raw.U, WidthChroma(true), WidthChroma(false), field.HeightChroma(false));
+                weave(field.m_raw.V, field.WidthChroma(true), m_raw.V, WidthChroma(true), WidthChroma(false), field.HeightChroma(false));
+            }
+
+            if (parity == 1)
+            {
+                ReplicateBoundary();
+            }
+        }
+
+        // Builds the filter taps for scaling frames of the size of frame into this one, ScaleFrom reuses them
+        // as long as the sizes and the filter stay the same
+        void PrepareScale(const Frame& frame, scaler::FILTER filter)
+        {
+            // alpha may be only 2 bits wide, a filter without overshoot keeps it in range
+            m_taps[0].Prepare(frame.m_w, frame.m_h, m_w, m_h, scaler::FILTER::BILINEAR);
+            m_taps[1].Prepare(frame.m_w, frame.m_h, m_w, m_h, filter);
+            m_taps[2].Prepare(frame.WidthChroma(false), frame.HeightChroma(false), WidthChroma(false), HeightChroma(false), filter);
+        }
+
+        // Resamples a frame of the same format and another size, chroma planes are scaled at their subsampled size
+        void ScaleFrom(const Frame& frame, scaler::FILTER filter)
+        {
+            if (GetChromaFmt() != frame.GetChromaFmt() || GetBitDepth() != frame.GetBitDepth())
+            {
+                std::invalid_argument e("Incompatible frame type!");
+                throw e;
+            }
+
+            auto maxValue = static_cast<Raw::value_t>((1 << GetBitDepth()) - 1);
+            PrepareScale(frame, filter);
+
+            if (HasAChannel() && !frame.m_raw.A.empty())
+            {
+                scaler::ScalePlane(frame.m_raw.A.data(), frame.m_wPadded, m_raw.A.data(), m_wPadded, m_taps[0], maxValue);
+            }
+
+            scaler::ScalePlane(frame.m_raw.Y.data(), frame.m_wPadded, m_raw.Y.data(), m_wPadded, m_taps[1], maxValue);
+
+            if (GetChromaFmt() != CHROMA_FORMAT::YUV_400)
+            {
+                scaler::ScalePlane(frame.m_raw.U.data(), frame.WidthChroma(true), m_raw.U.data(), WidthChroma(true), m_taps[2], maxValue);
+                scaler::ScalePlane(frame.m_raw.V.data(), frame.WidthChroma(true), m_raw.V.data(), WidthChroma(true), m_taps[2], maxValue);
+            }
+
+            ReplicateBoundary();
+        }
+
+        size_t Width(bool padded) const
+        {
+            return padded ? m_wPadded : m_w;
+        }
+
+        size_t Height(bool padded) const
+        {
+            return padded ? m_hPadded : m_h;
+        }
+
+        const Raw& GetRaw() const
+        {
+            return m_raw;
+        }
+
         void Allocate()
         {
             size_t pixelLuma = PixelLuma(true);
@@ -327,6 +543,12 @@ namespace frame
             m_raw.V.resize(pixelChroma / 2, 0);
         }
 
+        // Bytes held by the Raw planes once allocated
+        size_t RawSize() const
+        {
+            return (PixelLuma(true) * (HasAChannel() ? 2 : 1) + PixelChroma(true)) * sizeof(Raw::value_t);
+        }
+
         virtual ~Frame() = default;
         virtual size_t FrameSize(bool padded) const = 0;
         virtual CHROMA_FORMAT GetChromaFmt() const = 0;
@@ -335,11 +557,26 @@ namespace frame
         virtual void ReadFrame(const void* data) = 0;
         virtual void WriteFrame(void* data) const = 0;
 
+        // How the samples sit in the packed frame: little endian words of `bytes` bytes, each holding `count`
+        // samples of GetBitDepth() bits, the first one `shift` bits up and the others right above it
+        struct Packing
+        {
+            uint8_t bytes;
+            uint8_t count;
+            uint8_t shift;
+        };
+
+        virtual Packing GetPacking() const
+        {
+            return { static_cast<uint8_t>(GetBitDepth() > 8 ? 2 : 1), 1, 0 };
+        }
+
     protected:
+        // unpadded pixel counts describe the source frame, which is larger than the frame when cropping
         size_t PixelLuma(bool padded) const
         {
-            auto w = padded ? m_wPadded : m_w;
-            auto h = padded ? m_hPadded : m_h;
+            auto w = padded ? m_wPadded : m_srcW;
+            auto h = padded ? m_hPadded : m_srcH;
 
             return w * h;
         }
@@ -363,10 +600,20 @@ namespace frame
             }
         }
 
+    public:
         size_t WidthChroma(bool padded) const
         {
-            size_t widthLuma = padded ? m_wPadded : m_w;
+            return WidthChromaOf(padded ? m_wPadded : m_w);
+        }
+
+        size_t HeightChroma(bool padded) const
+        {
+            return HeightChromaOf(padded ? m_hPadded : m_h);
+        }
 
+    protected:
+        size_t WidthChromaOf(size_t widthLuma) const
+        {
             switch (GetChromaFmt())
             {
             case CHROMA_FORMAT::YUV_420:
@@ -381,10 +628,8 @@ namespace frame
             }
         }
 
-        size_t HeightChroma(bool padded) const
+        size_t HeightChromaOf(size_t heightLuma) const
         {
-            size_t heightLuma = padded ? m_hPadded : m_h;
-
             switch (GetChromaFmt())
             {
             case CHROMA_FORMAT::YUV_420:
@@ -467,15 +712,22 @@ namespace frame
         size_t m_wPadded = 0;
         size_t m_h = 0;
         size_t m_hPadded = 0;
+        size_t m_srcW = 0;
+        size_t m_srcH = 0;
+        size_t m_x0 = 0;
+        size_t m_y0 = 0;
         bool m_replic = false;
+        color::Spec m_color;
+        // ScaleFrom taps of the alpha, luma and chroma planes
+        scaler::PlaneTaps m_taps[3];
         Raw m_raw;
 
-        // logging
+        // logging, switched by conversions that may run side by side in one process
         std::string m_name;
-        static bool _logEnable;
+        static std::atomic<bool> _logEnable;
     };
 
-    bool Frame::_logEnable = false;
+    std::atomic<bool> Frame::_logEnable{false};
 
     template <typename pixel_t, CHROMA_FORMAT FMT, uint8_t DEPTH>
     class FrameNonPacked : public Frame
@@ -510,32 +762,60 @@ namespace frame
     public:
         FramePlanar(size_t w, size_t h, const std::string& name = "") : FrameNonPacked<pixel_t, FMT, DEPTH>(w, h, name) {}
 
+        Frame::Packing GetPacking() const override
+        {
+            return { sizeof(pixel_t), 1, SHIFT };
+        }
+
+        std::vector<std::pair<size_t, size_t>> CropRanges() const override
+        {
+            auto widthChroma = this->WidthChromaOf(this->m_srcW) * sizeof(pixel_t);
+            auto y0Chroma = this->HeightChromaOf(this->m_y0);
+            auto planeY = this->PixelLuma(false) * sizeof(pixel_t);
+            auto planeU = this->PixelChroma(false) / 2 * sizeof(pixel_t);
+            auto rowsY = std::make_pair(this->m_y0 * this->m_srcW * sizeof(pixel_t), (this->m_y0 + this->m_h) * this->m_srcW * sizeof(pixel_t));
+            auto rowsU = std::make_pair(y0Chroma * widthChroma, (y0Chroma + this->HeightChroma(false)) * widthChroma);
+
+            if (FMT == CHROMA_FORMAT::YUV_400)
+            {
+                return {rowsY};
+            }
+
+            return {rowsY,
+                    {planeY + rowsU.first, planeY + rowsU.second},
+                    {planeY + planeU + rowsU.first, planeY + planeU + rowsU.second}};
+        }
+
         void ReadFrame(const void* data) override
         {
             auto p = reinterpret_cast<const pixel_t*>(data);
-            size_t skipped = 0;
-            for (size_t i = 0; i < this->PixelLuma(false); i++)
+            for (size_t h = 0; h < this->m_h; h++)
             {
-                this->m_raw.Y[i + skipped] = p[i] >> SHIFT;
-                if (i % this->m_w == this->m_w - 1)
+                auto src = p + (this->m_y0 + h) * this->m_srcW + this->m_x0;
+                auto dst = &this->m_raw.Y[h * this->m_wPadded];
+                for (size_t w = 0; w < this->m_w; w++)
                 {
-                    skipped += this->m_wPadded - this->m_w;
+                    dst[w] = src[w] >> SHIFT;
                 }
             }
 
             auto widthChroma = this->WidthChroma(false);
             auto widthChromaPadded = this->WidthChroma(true);
+            auto widthChromaSrc = this->WidthChromaOf(this->m_srcW);
+            auto x0Chroma = this->WidthChromaOf(this->m_x0);
+            auto y0Chroma = this->HeightChromaOf(this->m_y0);
 
-            p += this->PixelLuma(false);
-            skipped = 0;
-            size_t pixelU = this->PixelChroma(false) / 2;
-            for (size_t i = 0; i < pixelU; i++)
+            auto pU = p + this->PixelLuma(false);
+            auto pV = pU + this->PixelChroma(false) / 2;
+            for (size_t h = 0; h < this->HeightChroma(false); h++)
             {
-                this->m_raw.U[i + skipped] = p[i] >> SHIFT;
-                this->m_raw.V[i + skipped] = p[i + pixelU] >> SHIFT;
-                if (i % widthChroma == widthChroma - 1)
+                auto offset = (y0Chroma + h) * widthChromaSrc + x0Chroma;
+                auto dstU = &this->m_raw.U[h * widthChromaPadded];
+                auto dstV = &this->m_raw.V[h * widthChromaPadded];
+                for (size_t w = 0; w < widthChroma; w++)
                 {
-                    skipped += widthChromaPadded - widthChroma;
+                    dstU[w] = pU[offset + w] >> SHIFT;
+                    dstV[w] = pV[offset + w] >> SHIFT;
                 }
             }
 
@@ -566,31 +846,50 @@ namespace frame
     public:
         FrameInterleaved(size_t w, size_t h, const std::string& name = "") : FrameNonPacked<pixel_t, FMT, DEPTH>(w, h, name) {}
 
+        Frame::Packing GetPacking() const override
+        {
+            return { sizeof(pixel_t), 1, SHIFT };
+        }
+
+        std::vector<std::pair<size_t, size_t>> CropRanges() const override
+        {
+            auto widthChroma = this->WidthChromaOf(this->m_srcW) * 2 * sizeof(pixel_t);
+            auto y0Chroma = this->HeightChromaOf(this->m_y0);
+            auto planeY = this->PixelLuma(false) * sizeof(pixel_t);
+
+            return {{this->m_y0 * this->m_srcW * sizeof(pixel_t), (this->m_y0 + this->m_h) * this->m_srcW * sizeof(pixel_t)},
+                    {planeY + y0Chroma * widthChroma, planeY + (y0Chroma + this->HeightChroma(false)) * widthChroma}};
+        }
+
         void ReadFrame(const void* data) override
         {
             auto p = reinterpret_cast<const pixel_t*>(data);
-            size_t skipped = 0;
-            for (size_t i = 0; i < this->PixelLuma(false); i++)
+            for (size_t h = 0; h < this->m_h; h++)
             {
-                this->m_raw.Y[i + skipped] = p[i] >> SHIFT;
-                if (i % this->m_w == this->m_w - 1)
+                auto src = p + (this->m_y0 + h) * this->m_srcW + this->m_x0;
+                auto dst = &this->m_raw.Y[h * this->m_wPadded];
+                for (size_t w = 0; w < this->m_w; w++)
                 {
-                    skipped += this->m_wPadded - this->m_w;
+                    dst[w] = src[w] >> SHIFT;
                 }
             }
 
             auto widthChroma = this->WidthChroma(false);
             auto widthChromaPadded = this->WidthChroma(true);
+            auto widthChromaSrc = this->WidthChromaOf(this->m_srcW);
+            auto x0Chroma = this->WidthChromaOf(this->m_x0);
+            auto y0Chroma = this->HeightChromaOf(this->m_y0);
 
             p += this->PixelLuma(false);
-            skipped = 0;
-            for (size_t i = 0; i < this->PixelChroma(false) / 2; i++)
+            for (size_t h = 0; h < this->HeightChroma(false); h++)
             {
-                this->m_raw.U[i + skipped] = p[2 * i + !UV] >> SHIFT;
-                this->m_raw.V[i + skipped] = p[2 * i + UV] >> SHIFT;
-                if (i % widthChroma == widthChroma - 1)
+                auto src = p + ((y0Chroma + h) * widthChromaSrc + x0Chroma) * 2;
+                auto dstU = &this->m_raw.U[h * widthChromaPadded];
+                auto dstV = &this->m_raw.V[h * widthChromaPadded];
+                for (size_t w = 0; w < widthChroma; w++)
                 {
-                    skipped += widthChromaPadded - widthChroma;
+                    dstU[w] = src[2 * w + !UV] >> SHIFT;
+                    dstV[w] = src[2 * w + UV] >> SHIFT;
                 }
             }
 
@@ -614,6 +913,150 @@ namespace frame
         }
     };
 
+    // Hardware surface layout of an interleaved frame: each plane is cut into tiles of TILE_W bytes by TILE_H
+    // rows, stored tile after tile in raster order, and a tile is made of COLUMN_W byte wide columns of TILE_H
+    // rows (one column for linear tiles, 16 byte columns for the Y-tiles of Intel GPUs). Planes are padded to
+    // whole tiles. ReadFrame detiles the rows it needs into a linear frame with a block copy per tile column,
+    // reading the tiles in memory order, then unpacks it as the linear type; WriteFrame does the reverse and
+    // zeroes the tile padding.
+    template <typename pixel_t, CHROMA_FORMAT FMT, uint8_t DEPTH, uint8_t SHIFT, size_t TILE_W, size_t TILE_H, size_t COLUMN_W = TILE_W>
+    class FrameTiled : public FrameInterleaved<pixel_t, FMT, DEPTH, SHIFT>
+    {
+        using Linear = FrameInterleaved<pixel_t, FMT, DEPTH, SHIFT>;
+
+    public:
+        FrameTiled(size_t w, size_t h, const std::string& name = "") : Linear(w, h, name) {}
+
+        size_t FrameSize(bool padded) const override
+        {
+            auto w = padded ? this->m_wPadded : this->m_srcW;
+            auto h = padded ? this->m_hPadded : this->m_srcH;
+
+            return Stride(RowBytesY(w)) * AlignRows(h) + Stride(RowBytesC(w)) * AlignRows(this->HeightChromaOf(h));
+        }
+
+        std::vector<std::pair<size_t, size_t>> CropRanges() const override
+        {
+            auto strideY = Stride(RowBytesY(this->m_srcW));
+            auto strideC = Stride(RowBytesC(this->m_srcW));
+            auto planeY = strideY * AlignRows(this->m_srcH);
+            auto y0Chroma = this->HeightChromaOf(this->m_y0);
+
+            return {{this->m_y0 / TILE_H * TILE_H * strideY, AlignRows(this->m_y0 + this->m_h) * strideY},
+                    {planeY + y0Chroma / TILE_H * TILE_H * strideC, planeY + AlignRows(y0Chroma + this->HeightChroma(false)) * strideC}};
+        }
+
+        size_t TileRows() const override
+        {
+            return TILE_H;
+        }
+
+        void ReadFrame(const void* data) override
+        {
+            auto p = reinterpret_cast<const char*>(data);
+            auto rowBytesY = RowBytesY(this->m_srcW);
+            auto rowBytesC = RowBytesC(this->m_srcW);
+            auto y0Chroma = this->HeightChromaOf(this->m_y0);
+            m_linear.resize(Linear::FrameSize(false));
+
+            Detile(p, m_linear.data(), rowBytesY, this->m_y0, this->m_y0 + this->m_h);
+            Detile(p + Stride(rowBytesY) * AlignRows(this->m_srcH), m_linear.data() + rowBytesY * this->m_srcH, rowBytesC,
+                   y0Chroma, y0Chroma + this->HeightChroma(false));
+
+            Linear::ReadFrame(m_linear.data());
+        }
+
+        void WriteFrame(void* data) const override
+        {
+            auto p = reinterpret_cast<char*>(data);
+            auto rowBytesY = RowBytesY(this->m_wPadded);
+            auto rowBytesC = RowBytesC(this->m_wPadded);
+            auto rowsC = this->HeightChroma(true);
+            m_linear.resize(Linear::FrameSize(true));
+            Linear::WriteFrame(m_linear.data());
+
+            Tile(m_linear.data(), p, rowBytesY, this->m_hPadded);
+            Tile(m_linear.data() + rowBytesY * this->m_hPadded, p + Stride(rowBytesY) * AlignRows(this->m_hPadded), rowBytesC, rowsC);
+        }
+
+    private:
+        static_assert(TILE_W % COLUMN_W == 0, "A tile is made of whole columns!");
+
+        size_t RowBytesY(size_t w) const
+        {
+            return w * sizeof(pixel_t);
+        }
+
+        size_t RowBytesC(size_t w) const
+        {
+            return this->WidthChromaOf(w) * 2 * sizeof(pixel_t);
+        }
+
+        static size_t Stride(size_t rowBytes)
+        {
+            return (rowBytes + TILE_W - 1) / TILE_W * TILE_W;
+        }
+
+        static size_t AlignRows(size_t rows)
+        {
+            return (rows + TILE_H - 1) / TILE_H * TILE_H;
+        }
+
+        // Offset of the column holding byte x of a row in a row of tiles, the column's TILE_H rows follow it
+        static size_t Column(size_t x)
+        {
+            return x / TILE_W * TILE_W * TILE_H + x % TILE_W / COLUMN_W * COLUMN_W * TILE_H;
+        }
+
+        // Rows [first, last) of a tiled plane into a linear plane of rowBytes wide rows
+        static void Detile(const char* tiled, char* linear, size_t rowBytes, size_t first, size_t last)
+        {
+            auto stride = Stride(rowBytes);
+            for (size_t ty = first / TILE_H; ty * TILE_H < last; ty++)
+            {
+                auto tiles = tiled + ty * TILE_H * stride;
+                auto r0 = std::max(first, ty * TILE_H);
+                auto r1 = std::min(last, (ty + 1) * TILE_H);
+                for (size_t x = 0; x < rowBytes; x += COLUMN_W)
+                {
+                    auto column = tiles + Column(x);
+                    auto n = std::min(COLUMN_W, rowBytes - x);
+                    for (size_t r = r0; r < r1; r++)
+                    {
+                        std::memcpy(linear + r * rowBytes + x, column + (r - ty * TILE_H) * COLUMN_W, n);
+                    }
+                }
+            }
+        }
+
+        // A linear plane of rows rows into whole tiles
+        static void Tile(const char* linear, char* tiled, size_t rowBytes, size_t rows)
+        {
+            auto stride = Stride(rowBytes);
+            for (size_t ty = 0; ty < AlignRows(rows) / TILE_H; ty++)
+            {
+                auto tiles = tiled + ty * TILE_H * stride;
+                for (size_t x = 0; x < stride; x += COLUMN_W)
+                {
+                    auto column = tiles + Column(x);
+                    for (size_t r = 0; r < TILE_H; r++)
+                    {
+                        auto row = ty * TILE_H + r;
+                        size_t n = 0;
+                        if (row < rows && x < rowBytes)
+                        {
+                            n = std::min(COLUMN_W, rowBytes - x);
+                            std::memcpy(column + r * COLUMN_W, linear + row * rowBytes + x, n);
+                        }
+                        std::memset(column + r * COLUMN_W + n, 0, COLUMN_W - n);
+                    }
+                }
+            }
+        }
+
+        mutable std::vector<char> m_linear;
+    };
+
     using I400 = FramePlanar<uint8_t, CHROMA_FORMAT::YUV_400, 8>;
     using I420 = FramePlanar<uint8_t, CHROMA_FORMAT::YUV_420, 8>;
     using NV12 = FrameInterleaved<uint8_t, CHROMA_FORMAT::YUV_420, 8>;
@@ -632,6 +1075,25 @@ namespace frame
     using NV24 = FrameInterleaved<uint8_t, CHROMA_FORMAT::YUV_444, 8>;
     using P410 = FrameInterleaved<uint16_t, CHROMA_FORMAT::YUV_444, 10>;
     using P416 = FrameInterleaved<uint16_t, CHROMA_FORMAT::YUV_444, 16>;
+    using GRAY10LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_400, 10>;
+    using GRAY12LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_400, 12>;
+    using GRAY16LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_400, 16>;
+    using YUV420P10LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_420, 10>;
+    using YUV420P12LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_420, 12>;
+    using YUV420P16LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_420, 16>;
+    using YUV422P10LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_422, 10>;
+    using YUV422P12LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_422, 12>;
+    using YUV422P16LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_422, 16>;
+    using YUV444P12LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_444, 12>;
+    using YUV444P16LE = FramePlanar<uint16_t, CHROMA_FORMAT::YUV_444, 16>;
+    // linear tiles of 4x4, 16x16, 32x32 and 64x32 pixels as V4L2 decoders write them, and Intel Y-tiles
+    using NV12_4L4 = FrameTiled<uint8_t, CHROMA_FORMAT::YUV_420, 8, 0, 4, 4>;
+    using NV12_16L16 = FrameTiled<uint8_t, CHROMA_FORMAT::YUV_420, 8, 0, 16, 16>;
+    using NV12_32L32 = FrameTiled<uint8_t, CHROMA_FORMAT::YUV_420, 8, 0, 32, 32>;
+    using NV12_64L32 = FrameTiled<uint8_t, CHROMA_FORMAT::YUV_420, 8, 0, 64, 32>;
+    using NV12_YTILE = FrameTiled<uint8_t, CHROMA_FORMAT::YUV_420, 8, 0, 128, 32, 16>;
+    using P010_4L4 = FrameTiled<uint16_t, CHROMA_FORMAT::YUV_420, 10, 6, 8, 4>;
+    using P010_YTILE = FrameTiled<uint16_t, CHROMA_FORMAT::YUV_420, 10, 6, 128, 32, 16>;
 
     template <typename pixel_t, bool YFIRST>
     struct PixelPacked422
@@ -652,9 +1114,21 @@ namespace frame
     public:
         Packed422(size_t w, size_t h, const std::string& name = "") : Frame(w, h, name) {}
 
+        Packing GetPacking() const override
+        {
+            return { sizeof(pixel_t) / 2, 1, SHIFT };
+        }
+
         size_t FrameSize(bool padded) const override
         {
-            return (padded ? m_wPadded * m_hPadded : m_w * m_h) * sizeof(PixelPacked422<pixel_t, YFIRST>);
+            return PixelLuma(padded) * sizeof(PixelPacked422<pixel_t, YFIRST>);
+        }
+
+        std::vector<std::pair<size_t, size_t>> CropRanges() const override
+        {
+            auto stride = m_srcW * sizeof(PixelPacked422<pixel_t, YFIRST>);
+
+            return {{m_y0 * stride, (m_y0 + m_h) * stride}};
         }
 
         CHROMA_FORMAT GetChromaFmt() const override
@@ -675,21 +1149,21 @@ namespace frame
         void ReadFrame(const void* data) override
         {
             auto p = reinterpret_cast<const PixelPacked422<pixel_t, YFIRST>*>(data);
-            size_t skipped = 0;
-            for (size_t i = 0; i < m_w * m_h; ++i)
+            for (size_t h = 0; h < m_h; h++)
             {
-                m_raw.Y[i + skipped] = p[i].Y >> SHIFT;
-                if ((i + skipped) % 2 == 0)
+                auto src = p + (m_y0 + h) * m_srcW + m_x0;
+                auto dst = h * m_wPadded;
+                for (size_t w = 0; w < m_w; w++)
                 {
-                    m_raw.U[(i + skipped) / 2] = p[i].Chroma >> SHIFT;
-                }
-                else
-                {
-                    m_raw.V[(i + skipped) / 2] = p[i].Chroma >> SHIFT;
-                }
-                if (i % m_w == m_w - 1)
-                {
-                    skipped += m_wPadded - m_w;
+                    m_raw.Y[dst + w] = src[w].Y >> SHIFT;
+                    if ((dst + w) % 2 == 0)
+                    {
+                        m_raw.U[(dst + w) / 2] = src[w].Chroma >> SHIFT;
+                    }
+                    else
+                    {
+                        m_raw.V[(dst + w) / 2] = src[w].Chroma >> SHIFT;
+                    }
                 }
             }
 
@@ -720,15 +1194,178 @@ namespace frame
     using Y210 = Packed422<uint32_t, 10, 6>;
     using Y216 = Packed422<uint32_t, 16>;
 
-    template <typename pixel_t, uint8_t DEPTH>
+    // v210: 4:2:2 10-bit, every 6 pixels are four little endian words of three 10-bit samples
+    // (Cb0 Y0 Cr0 | Y1 Cb2 Y2 | Cr2 Y3 Cb4 | Y4 Cr4 Y5) and rows are padded to 128 bytes (48 pixels). Whole
+    // groups are unpacked and packed word by word straight into the Raw planes; a group cut by the crop window
+    // or the end of the row goes through a staged group, and the padding of written rows is zeroed.
+    class V210 : public Frame
+    {
+    public:
+        V210(size_t w, size_t h, const std::string& name = "") : Frame(w, h, name) {}
+
+        Packing GetPacking() const override
+        {
+            return { 4, 3, 0 };
+        }
+
+        size_t FrameSize(bool padded) const override
+        {
+            return Stride(padded ? m_wPadded : m_srcW) * (padded ? m_hPadded : m_srcH);
+        }
+
+        std::vector<std::pair<size_t, size_t>> CropRanges() const override
+        {
+            auto stride = Stride(m_srcW);
+
+            return {{m_y0 * stride, (m_y0 + m_h) * stride}};
+        }
+
+        CHROMA_FORMAT GetChromaFmt() const override
+        {
+            return CHROMA_FORMAT::YUV_422;
+        }
+
+        uint8_t GetBitDepth() const override
+        {
+            return 10;
+        }
+
+        bool HasAChannel() const override
+        {
+            return false;
+        }
+
+        void ReadFrame(const void* data) override
+        {
+            auto p = reinterpret_cast<const uint8_t*>(data);
+            auto stride = Stride(m_srcW);
+            for (size_t h = 0; h < m_h; h++)
+            {
+                auto src = p + (m_y0 + h) * stride;
+                auto dstY = &m_raw.Y[h * m_wPadded];
+                auto dstU = &m_raw.U[h * m_wPadded / 2];
+                auto dstV = &m_raw.V[h * m_wPadded / 2];
+                for (size_t x = 0; x < m_w;)
+                {
+                    auto sx = m_x0 + x;
+                    auto skip = sx % GROUP;
+                    auto n = std::min(GROUP - skip, m_w - x);
+                    auto group = src + sx / GROUP * GROUP_BYTES;
+                    if (n == GROUP)
+                    {
+                        Unpack(group, dstY + x, dstU + x / 2, dstV + x / 2);
+                    }
+                    else
+                    {
+                        Raw::value_t y[GROUP];
+                        Raw::value_t u[GROUP / 2];
+                        Raw::value_t v[GROUP / 2];
+                        Unpack(group, y, u, v);
+                        std::copy(y + skip, y + skip + n, dstY + x);
+                        // an odd last pixel still has its chroma pair in the group
+                        std::copy(u + skip / 2, u + (skip + n + 1) / 2, dstU + x / 2);
+                        std::copy(v + skip / 2, v + (skip + n + 1) / 2, dstV + x / 2);
+                    }
+                    x += n;
+                }
+            }
+
+            ReplicateBoundary();
+        }
+
+        void WriteFrame(void* data) const override
+        {
+            auto p = reinterpret_cast<uint8_t*>(data);
+            auto stride = Stride(m_wPadded);
+            for (size_t h = 0; h < m_hPadded; h++)
+            {
+                auto dst = p + h * stride;
+                auto srcY = &m_raw.Y[h * m_wPadded];
+                auto srcU = &m_raw.U[h * m_wPadded / 2];
+                auto srcV = &m_raw.V[h * m_wPadded / 2];
+                size_t x = 0;
+                for (; x + GROUP <= m_wPadded; x += GROUP, dst += GROUP_BYTES)
+                {
+                    Pack(srcY + x, srcU + x / 2, srcV + x / 2, dst);
+                }
+                if (x < m_wPadded)
+                {
+                    Raw::value_t y[GROUP] = {0};
+                    Raw::value_t u[GROUP / 2] = {0};
+                    Raw::value_t v[GROUP / 2] = {0};
+                    std::copy(srcY + x, srcY + m_wPadded, y);
+                    std::copy(srcU + x / 2, srcU + m_wPadded / 2, u);
+                    std::copy(srcV + x / 2, srcV + m_wPadded / 2, v);
+                    Pack(y, u, v, dst);
+                    dst += GROUP_BYTES;
+                }
+                std::memset(dst, 0, p + (h + 1) * stride - dst);
+            }
+        }
+
+    private:
+        static constexpr size_t GROUP = 6;
+        static constexpr size_t GROUP_BYTES = 16;
+        static constexpr size_t ROW_ALIGN = 128;
+
+        static size_t Stride(size_t width)
+        {
+            return ((width + GROUP - 1) / GROUP * GROUP_BYTES + ROW_ALIGN - 1) & ~(ROW_ALIGN - 1);
+        }
+
+        static void Unpack(const uint8_t* group, Raw::value_t* y, Raw::value_t* u, Raw::value_t* v)
+        {
+            uint32_t w[4];
+            std::memcpy(w, group, sizeof(w));
+            u[0] = w[0] & 0x3FF;
+            y[0] = w[0] >> 10 & 0x3FF;
+            v[0] = w[0] >> 20 & 0x3FF;
+            y[1] = w[1] & 0x3FF;
+            u[1] = w[1] >> 10 & 0x3FF;
+            y[2] = w[1] >> 20 & 0x3FF;
+            v[1] = w[2] & 0x3FF;
+            y[3] = w[2] >> 10 & 0x3FF;
+            u[2] = w[2] >> 20 & 0x3FF;
+            y[4] = w[3] & 0x3FF;
+            v[2] = w[3] >> 10 & 0x3FF;
+            y[5] = w[3] >> 20 & 0x3FF;
+        }
+
+        static void Pack(const Raw::value_t* y, const Raw::value_t* u, const Raw::value_t* v, uint8_t* group)
+        {
+            auto word = [](uint32_t a, uint32_t b, uint32_t c) {
+                return (a & 0x3FF) | (b & 0x3FF) << 10 | (c & 0x3FF) << 20;
+            };
+            uint32_t w[4] = { word(u[0], y[0], v[0]), word(y[1], u[1], y[2]), word(v[1], y[3], u[2]), word(y[4], v[2], y[5]) };
+            std::memcpy(group, w, sizeof(w));
+        }
+    };
+
+    // ALPHA is false for layouts without an alpha sample, the frame then has no A plane
+    template <typename pixel_t, uint8_t DEPTH, bool ALPHA = true>
     class Packed444A : public Frame
     {
     public:
         Packed444A(size_t w, size_t h, const std::string &name = "") : Frame(w, h, name) {}
 
+        // y410 has its three samples from bit 0 up, v410 above two unused bits
+        Packing GetPacking() const override
+        {
+            if (sizeof(pixel_t) == 4 && DEPTH == 10)
+            {
+                return { 4, 3, static_cast<uint8_t>(ALPHA ? 0 : 2) };
+            }
+            return Frame::GetPacking();
+        }
+
         size_t FrameSize(bool padded) const override
         {
-            return (padded ? m_wPadded * m_hPadded : m_w * m_h) * sizeof(pixel_t);
+            return PixelLuma(padded) * sizeof(pixel_t);
+        }
+
+        std::vector<std::pair<size_t, size_t>> CropRanges() const override
+        {
+            return {{m_y0 * m_srcW * sizeof(pixel_t), (m_y0 + m_h) * m_srcW * sizeof(pixel_t)}};
         }
 
         CHROMA_FORMAT GetChromaFmt() const override
@@ -743,22 +1380,25 @@ namespace frame
 
         bool HasAChannel() const override
         {
-            return true;
+            return ALPHA;
         }
 
         void ReadFrame(const void* data) override
         {
             auto p = reinterpret_cast<const pixel_t*>(data);
-            size_t skipped = 0;
-            for (size_t i = 0; i < m_w * m_h; ++i)
+            for (size_t h = 0; h < m_h; h++)
             {
-                m_raw.A[i + skipped] = p[i].A;
-                m_raw.Y[i + skipped] = p[i].Y;
-                m_raw.U[i + skipped] = p[i].U;
-                m_raw.V[i + skipped] = p[i].V;
-                if (i % m_w == m_w - 1)
+                auto src = p + (m_y0 + h) * m_srcW + m_x0;
+                auto dst = h * m_wPadded;
+                for (size_t w = 0; w < m_w; w++)
                 {
-                    skipped += m_wPadded - m_w;
+                    if constexpr (ALPHA)
+                    {
+                        m_raw.A[dst + w] = src[w].A;
+                    }
+                    m_raw.Y[dst + w] = src[w].Y;
+                    m_raw.U[dst + w] = src[w].U;
+                    m_raw.V[dst + w] = src[w].V;
                 }
             }
 
@@ -768,12 +1408,18 @@ namespace frame
         void WriteFrame(void* data) const override
         {
             auto p = reinterpret_cast<pixel_t*>(data);
-            for (size_t i = 0; i < m_raw.A.size(); ++i)
+            for (size_t i = 0; i < m_raw.Y.size(); ++i)
             {
-                p[i].A = m_raw.A[i];
-                p[i].Y = m_raw.Y[i];
-                p[i].U = m_raw.U[i];
-                p[i].V = m_raw.V[i];
+                // built whole, so bits outside the samples are written as zero
+                pixel_t px{};
+                if constexpr (ALPHA)
+                {
+                    px.A = m_raw.A[i];
+                }
+                px.Y = m_raw.Y[i];
+                px.U = m_raw.U[i];
+                px.V = m_raw.V[i];
+                p[i] = px;
             }
         }
     };
@@ -805,6 +1451,39 @@ namespace frame
         uint64_t A : 16;
     };
     using Y416 = Packed444A<PixelY416, 16>;
+
+    // v410: 4:4:4 10-bit, one little endian word per pixel with two unused low bits
+    struct PixelV410
+    {
+        uint32_t X : 2;
+        uint32_t U : 10;
+        uint32_t Y : 10;
+        uint32_t V : 10;
+    };
+    using V410 = Packed444A<PixelV410, 10, false>;
+
+    // Every frame type accepted by name, X(T) is expanded once per type
+#define FRAME_TYPES(X) \
+    X(I400) X(I420) X(NV12) X(P010) X(P012) X(P016) X(NV21) \
+    X(I422) X(NV16) X(P210) X(P216) X(YUYV) X(YUY2) X(UYVY) X(Y210) X(Y216) X(V210) \
+    X(I440) X(I444) X(YUV444P10LE) X(NV42) X(VUYX) X(AYUV) X(Y410) X(Y416) X(V410) X(NV24) X(P410) X(P416) \
+    X(GRAY10LE) X(GRAY12LE) X(GRAY16LE) X(YUV420P10LE) X(YUV420P12LE) X(YUV420P16LE) \
+    X(YUV422P10LE) X(YUV422P12LE) X(YUV422P16LE) X(YUV444P12LE) X(YUV444P16LE) \
+    X(NV12_4L4) X(NV12_16L16) X(NV12_32L32) X(NV12_64L32) X(NV12_YTILE) X(P010_4L4) X(P010_YTILE)
+
+#define FRAME_TYPE_NAME(T) #T,
+    static constexpr const char* TYPES[] = { FRAME_TYPES(FRAME_TYPE_NAME) };
+#undef FRAME_TYPE_NAME
+
+    // Creates a frame from its upper case type name, nullptr for an unknown type
+    inline Frame* Create(const std::string& type, size_t width, size_t height, const std::string& name)
+    {
+#define FRAME_TYPE_CREATE(T) if (#T == type) return CREATE_FRAME(T, width, height, name);
+        FRAME_TYPES(FRAME_TYPE_CREATE)
+#undef FRAME_TYPE_CREATE
+
+        return nullptr;
+    }
 }
 
 #pragma pack(pop)
@@ -1,66 +1,1609 @@
 #include <algorithm>
+#include <array>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <future>
+#include <initializer_list>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+#include "affinity.hpp"
+#include "color.hpp"
+#include "dedup.hpp"
+#include "digest.hpp"
+#include "file_stream.hpp"
 #include "frame.hpp"
+#include "frame_selection.hpp"
 #include "fourcc.h"
+#include "metrics.hpp"
+#include "pool.hpp"
+#include "progress.hpp"
+#include "y4m.hpp"
 
 namespace converter
 {
+    // --fields, interlaced frames taken apart into their fields or put back together
+    enum class FIELDS
+    {
+        OFF,
+        SPLIT,
+        WEAVE
+    };
+
     template <typename IStream, typename OStream>
     class FrameConverter final
     {
     public:
         FrameConverter() = default;
 
-        int Execute(int argc, const char* const * argv)
-        {
-            frmIn = new frame::Frame * [coreNum] {nullptr};
-            frmOut = new frame::Frame * [coreNum] {nullptr};
+        ~FrameConverter()
+        {
+            delete[] frmIn;
+            delete[] frmOut;
+            delete[] frmRef;
+            delete[] frmScaled;
+        }
+
+        // Jobs of a resident server borrow its threads and frame buffers instead of starting and allocating
+        // their own, either may be null
+        void SetPools(pool::Workers* workerPool, pool::Buffers* bufferPool)
+        {
+            workers = workerPool;
+            buffers = bufferPool;
+        }
+
+        int Execute(int argc, const char* const * argv)
+        {
+            const int ret = Run(argc, argv);
+            // the last progress line is printed once the job is over, with its outcome
+            if (reporter && ret == 0)
+            {
+                reporter->Succeeded();
+            }
+            reporter.reset();
+
+            return ret;
+        }
+
+    private:
+        int Run(int argc, const char* const * argv)
+        {
+            if (ParseArgs(argc, argv) != 0)
+            {
+                return help ? 0 : -1;
+            }
+
+            if (compare)
+            {
+                return Compare();
+            }
+            if (split || concat)
+            {
+                return Sequence();
+            }
+            if (fields != FIELDS::OFF)
+            {
+                return Fields();
+            }
+
+            for (size_t i = 0; i < coreNum; i++)
+            {
+                frmIn[i]->SetPadding(alignment, replicate);
+                frmOut[i]->SetPadding(alignment, replicate);
+                frmOut[i]->SetColor(colorSpec);
+                if (frmScaled[i])
+                {
+                    frmScaled[i]->SetPadding(alignment, replicate);
+                }
+                for (auto& out : fanOut)
+                {
+                    out->frm[i]->SetPadding(alignment, replicate);
+                    out->frm[i]->SetColor(colorSpec);
+                }
+            }
+            for (auto& out : fanOut)
+            {
+                out->frmSz = out->frm[0]->FrameSize(true);
+            }
+
+            const size_t frmSzIn = frmIn[0]->FrameSize(false);
+            const size_t frmSzOut = frmOut[0]->FrameSize(true);
+            if (maxMemory != 0)
+            {
+                // a slot is the packed input and output frames plus the Raw planes of every stage
+                size_t slotSz = frmSzIn + frmSzOut + frmIn[0]->RawSize() + frmOut[0]->RawSize() +
+                    (frmScaled[0] ? frmScaled[0]->RawSize() : 0);
+                for (const auto& out : fanOut)
+                {
+                    slotSz += out->frmSz + out->frm[0]->RawSize();
+                }
+                if (slotSz > maxMemory)
+                {
+                    return ExecuteBands(frmSzIn, frmSzOut, slotSz);
+                }
+                coreNum = std::min(coreNum, maxMemory / slotSz);
+                memPlanned = coreNum * slotSz;
+            }
+            if (!SetStrips(frmSzIn, frmSzOut))
+            {
+                return -1;
+            }
+            auto memIn = pool::Take(buffers, frmSzIn * coreNum);
+            auto memOut = pool::Take(buffers, frmSzOut * coreNum);
+            auto bufIn = memIn.get();
+            auto bufOut = memOut.get();
+            for (auto& out : fanOut)
+            {
+                out->buf = pool::Take(buffers, out->frmSz * coreNum);
+            }
+
+            // every slot is set up on its worker's cpus, so its Raw planes and its part of the I/O buffers are
+            // first touched on that worker's NUMA node
+            ForEachSlot([=](size_t i) {
+                frmIn[i]->Allocate();
+                if (frmScaled[i])
+                {
+                    frmScaled[i]->Allocate();
+                    frmScaled[i]->PrepareScale(*frmIn[i], filter);
+                }
+                if (stripH != 0)
+                {
+                    if (tailIn[i] != frmIn[i])
+                    {
+                        tailIn[i]->Allocate();
+                    }
+                    stripBuf[i].resize(frmOut[0]->FrameSize(false));
+                }
+                std::memset(bufIn + frmSzIn * i, 0, frmSzIn);
+                std::memset(bufOut + frmSzOut * i, 0, frmSzOut);
+                for (auto& out : fanOut)
+                {
+                    std::memset(out->buf.get() + out->frmSz * i, 0, out->frmSz);
+                }
+            });
+
+            for (auto& out : fanOut)
+            {
+                if (out->y4m)
+                {
+                    out->hdr.w = out->frm[0]->Width(true);
+                    out->hdr.h = out->frm[0]->Height(true);
+                    auto hdr = y4m::Format(out->hdr);
+                    out->fs.write(hdr.data(), hdr.size());
+                }
+            }
+            std::string hdrOut;
+            if (y4mOut)
+            {
+                y4mHdr.w = frmOut[0]->Width(true);
+                // strip frames are full width but only a strip high
+                y4mHdr.h = stripH != 0 ? h : frmOut[0]->Height(true);
+                hdrOut = y4m::Format(y4mHdr);
+            }
+
+            // a raw input that knows its size bounds the selection and is read by offset, pipes and Y4M streams
+            // are read in order and step over unselected frames
+            const size_t frames = y4mIn ? selection::OPEN : CountFrames(fsIn, frmSzIn);
+            seekIn = frames != selection::OPEN;
+            if (!seekIn)
+            {
+                cropRanges.clear();
+            }
+            selection::Cursor cursor(ranges, every, reverse, limit, frames);
+            if (!cursor.Valid())
+            {
+                return -1;
+            }
+
+            // the sidecar of the interrupted run is read before it is started over
+            const auto recorded = resume ? ReadSidecar(hashFile) : std::unordered_map<size_t, std::string>();
+            std::ofstream fsHash;
+            if (!hashFile.empty())
+            {
+                fsHash.open(hashFile, std::ios::out);
+                if (!fsHash)
+                {
+                    return -1;
+                }
+                fsHash << "# sha256: <frame index> <output frame>" << (hashIn ? " <input frame>" : "") << ", * for the whole stream\n";
+            }
+            std::ofstream fsMap;
+            if (!dedupMap.empty())
+            {
+                fsMap.open(dedupMap, std::ios::out);
+                if (!fsMap)
+                {
+                    return -1;
+                }
+                fsMap << "# dedup: <frame index> <output frame that was converted for it>\n";
+            }
+            const size_t total = cursor.Count();
+            if (resume)
+            {
+                if (!Resume(cursor, hdrOut, frmSzOut, recorded, fsHash, bufOut))
+                {
+                    return -1;
+                }
+            }
+            else if (y4mOut)
+            {
+                Write(hdrOut.data(), hdrOut.size());
+            }
+            StartProgress(total);
+            std::vector<std::string> digestIn(coreNum);
+            std::vector<std::string> digestOut(coreNum);
+            std::vector<size_t> index(coreNum);
+            std::vector<size_t> source(coreNum);
+            std::vector<size_t> shown(coreNum);
+            std::vector<uint64_t> hashes(coreNum);
+            size_t outFrames = 0;
+            size_t duplicates = 0;
+
+            size_t frmNum2Read = 0;
+            size_t frmNumRead = 0;
+            while ((frmNum2Read = cursor.Next(index.data(), coreNum)) > 0 &&
+                (frmNumRead = ReadFrames(bufIn, frmSzIn, index.data(), frmNum2Read)) > 0)
+            {
+                // every slot converts its frame unless it repeats the last converted one
+                for (size_t i = 0; i < frmNumRead; i++)
+                {
+                    source[i] = i;
+                }
+                if (dedupMode != dedup::MODE::OFF)
+                {
+                    FindDuplicates(bufIn, frmSzIn, frmNumRead, hashes, source, digestIn);
+                }
+                std::vector<std::future<void>> tasks;
+                for (size_t i = 0; i < frmNumRead; i++)
+                {
+                    if (source[i] != i)
+                    {
+                        continue;
+                    }
+                    tasks.push_back(Async([=, &digestIn, &digestOut]() {
+                        PinWorker(i);
+                        // digests are taken while the frame is still hot in this worker's cache
+                        if (hashIn && dedupMode == dedup::MODE::OFF)
+                        {
+                            digestIn[i] = digest::Of(bufIn + frmSzIn * i, frmSzIn);
+                        }
+                        if (stripH != 0)
+                        {
+                            ConvertStrips(i, bufIn + frmSzIn * i, bufOut + frmSzOut * i);
+                        }
+                        else
+                        {
+                            frmIn[i]->ReadFrame(bufIn + frmSzIn * i);
+                            if (frmScaled[i])
+                            {
+                                // resample in the input format, then convert at the output size
+                                frmScaled[i]->ScaleFrom(*frmIn[i], filter);
+                            }
+                            frame::Frame* src = frmScaled[i] ? frmScaled[i] : frmIn[i];
+                            // the frame is unpacked once, every other output converts from it alongside
+                            std::vector<std::future<void>> fan;
+                            for (auto& out : fanOut)
+                            {
+                                Output* o = out.get();
+                                fan.push_back(Async([=]() {
+                                    PinWorker(i);
+                                    o->frm[i]->ConvertFrom(*src);
+                                    o->frm[i]->WriteFrame(o->buf.get() + o->frmSz * i);
+                                }));
+                            }
+                            if (fanOut.empty())
+                            {
+                                // the planes the output keeps as they are change hands instead of being copied
+                                frmOut[i]->MoveFrom(*src);
+                            }
+                            else
+                            {
+                                frmOut[i]->ConvertFrom(*src);
+                            }
+                            frmOut[i]->WriteFrame(bufOut + frmSzOut * i);
+                            Wait(fan);
+                        }
+                        if (!hashFile.empty())
+                        {
+                            digestOut[i] = digest::Of(bufOut + frmSzOut * i, frmSzOut);
+                        }
+                        progress::Add(counters.frames, 1);
+                    }));
+                }
+                if (hashIn)
+                {
+                    // the whole stream digest is sequential, overlap it with the conversion
+                    tasks.push_back(Async([&]() { digest::Update(hasherIn, bufIn, frmSzIn * frmNumRead); }));
+                }
+                Wait(tasks);
+
+                // a duplicate shows the output of the frame it repeats, copied into its slot or dropped
+                for (size_t i = 0; i < frmNumRead; i++)
+                {
+                    const size_t from = source[i];
+                    if (from == i)
+                    {
+                        shown[i] = outFrames++;
+                        continue;
+                    }
+                    duplicates++;
+                    progress::Add(counters.frames, 1);
+                    shown[i] = from == KEPT ? kept.frame : shown[from];
+                    if (dedupMode == dedup::MODE::REUSE)
+                    {
+                        std::memcpy(bufOut + frmSzOut * i, from == KEPT ? kept.out.data() : bufOut + frmSzOut * from, frmSzOut);
+                        digestOut[i] = from == KEPT ? kept.digest : digestOut[from];
+                        for (auto& out : fanOut)
+                        {
+                            std::memcpy(out->buf.get() + out->frmSz * i,
+                                        from == KEPT ? out->kept.data() : out->buf.get() + out->frmSz * from, out->frmSz);
+                        }
+                        outFrames++;
+                    }
+                }
+
+                // dropped duplicates split the batch into runs of frames written together
+                auto dropped = [&](size_t i) { return dedupMode == dedup::MODE::DROP && source[i] != i; };
+                for (size_t i = 0; i < frmNumRead;)
+                {
+                    if (dropped(i))
+                    {
+                        i++;
+                        continue;
+                    }
+                    size_t run = 1;
+                    while (i + run < frmNumRead && !dropped(i + run))
+                    {
+                        run++;
+                    }
+                    WriteFrames(bufOut + frmSzOut * i, frmSzOut, run);
+                    for (auto& out : fanOut)
+                    {
+                        WriteFrames(*out, i, run);
+                    }
+                    i += run;
+                }
+                for (size_t i = 0; fsHash.is_open() && i < frmNumRead; i++)
+                {
+                    if (!dropped(i))
+                    {
+                        fsHash << index[i] << " " << digestOut[i] << (hashIn ? " " + digestIn[i] : "") << "\n";
+                    }
+                }
+                for (size_t i = 0; fsMap.is_open() && i < frmNumRead; i++)
+                {
+                    fsMap << index[i] << " " << shown[i] << "\n";
+                }
+
+                if (dedupMode != dedup::MODE::OFF)
+                {
+                    KeepLast(bufIn, frmSzIn, bufOut, frmSzOut, frmNumRead, hashes, source, shown, digestOut);
+                }
+            }
+
+            if (fsHash.is_open())
+            {
+                fsHash << "* " << digest::Final(hasherOut) << (hashIn ? " " + digest::Final(hasherIn) : "") << "\n";
+            }
+            ReportMemory(0);
+            if (dedupMode != dedup::MODE::OFF && !toStdout && !quiet)
+            {
+                std::cout << duplicates << " duplicate frames " << (dedupMode == dedup::MODE::DROP ? "dropped" : "reused") << std::endl;
+            }
+
+            return 0;
+        }
+
+        // An output after the first -o, converted from the same Raw input frames into its own frames and buffer
+        struct Output
+        {
+            std::string type;
+            OStream fs;
+            bool y4m = false;
+            y4m::Header hdr;
+            std::vector<frame::Frame*> frm;
+            size_t frmSz = 0;
+            pool::Buffer buf;
+            // the last converted frame, for duplicates in the next batch
+            std::vector<char> kept;
+        };
+
+        // The last converted frame with --dedup. Duplicates are matched against it rather than against the frame
+        // just before them, so a slow fade is not swallowed a threshold at a time, and a duplicate at the start
+        // of a batch still finds it after its slot was reused.
+        struct Kept
+        {
+            bool valid = false;
+            std::vector<char> in;
+            std::vector<char> out;
+            uint64_t hash = 0;
+            std::string digest;
+            size_t frame = 0;
+        };
+
+        // source[i] of a duplicate that repeats the kept frame of an earlier batch
+        static constexpr size_t KEPT = static_cast<size_t>(-1);
+
+        // The hashes are taken on the workers, then each frame is matched in order against the last converted
+        // one. An equal hash is confirmed byte for byte, near duplicates are looked for only with a threshold.
+        void FindDuplicates(const char* buf, size_t frmSz, size_t frmNum, std::vector<uint64_t>& hashes,
+                            std::vector<size_t>& source, std::vector<std::string>& digestIn)
+        {
+            std::vector<std::future<void>> tasks;
+            for (size_t i = 0; i < frmNum; i++)
+            {
+                tasks.push_back(Async([=, &hashes, &digestIn]() {
+                    PinWorker(i);
+                    hashes[i] = dedup::Hash(buf + frmSz * i, frmSz);
+                    // a duplicate is not converted, its input digest is taken here
+                    if (hashIn)
+                    {
+                        digestIn[i] = digest::Of(buf + frmSz * i, frmSz);
+                    }
+                }));
+            }
+            Wait(tasks);
+
+            const auto packing = frmIn[0]->GetPacking();
+            const dedup::Samples samples{ packing.bytes, packing.count, packing.shift, frmIn[0]->GetBitDepth() };
+            size_t ref = kept.valid ? KEPT : frmNum;
+            for (size_t i = 0; i < frmNum; i++)
+            {
+                const char* frm = buf + frmSz * i;
+                bool dup = false;
+                if (ref != frmNum)
+                {
+                    const char* refFrm = ref == KEPT ? kept.in.data() : buf + frmSz * ref;
+                    const uint64_t refHash = ref == KEPT ? kept.hash : hashes[ref];
+                    dup = (hashes[i] == refHash && std::memcmp(frm, refFrm, frmSz) == 0) ||
+                        (dedupThreshold > 0 && dedup::Similar(frm, refFrm, frmSz, dedupThreshold, samples));
+                }
+                source[i] = dup ? ref : i;
+                ref = dup ? ref : i;
+            }
+        }
+
+        // Copies out the last frame of the batch that was converted, the buffers are refilled by the next read
+        void KeepLast(const char* bufIn, size_t frmSzIn, const char* bufOut, size_t frmSzOut, size_t frmNum,
+                      const std::vector<uint64_t>& hashes, const std::vector<size_t>& source,
+                      const std::vector<size_t>& shown, const std::vector<std::string>& digestOut)
+        {
+            size_t last = frmNum;
+            while (last > 0 && source[last - 1] != last - 1)
+            {
+                last--;
+            }
+            if (last-- == 0)
+            {
+                return;
+            }
+
+            kept.valid = true;
+            kept.in.assign(bufIn + frmSzIn * last, bufIn + frmSzIn * (last + 1));
+            kept.hash = hashes[last];
+            kept.frame = shown[last];
+            if (dedupMode == dedup::MODE::REUSE)
+            {
+                kept.out.assign(bufOut + frmSzOut * last, bufOut + frmSzOut * (last + 1));
+                kept.digest = digestOut[last];
+                for (auto& out : fanOut)
+                {
+                    const char* frm = out->buf.get() + out->frmSz * last;
+                    out->kept.assign(frm, frm + out->frmSz);
+                }
+            }
+        }
+
+        // Frame index to output digest of a --hash sidecar, empty when there is none
+        static std::unordered_map<size_t, std::string> ReadSidecar(const std::string& path)
+        {
+            std::unordered_map<size_t, std::string> recorded;
+            std::ifstream fs(path);
+            std::string line;
+            while (!path.empty() && std::getline(fs, line))
+            {
+                // '#' starts the comment, '*' the whole stream digests
+                auto sp = line.find(' ');
+                if (line.empty() || line[0] == '#' || line[0] == '*' || sp == std::string::npos)
+                {
+                    continue;
+                }
+                auto end = line.find(' ', sp + 1);
+                recorded[std::strtoull(line.c_str(), nullptr, 10)] = line.substr(sp + 1, end == std::string::npos ? end : end - sp - 1);
+            }
+
+            return recorded;
+        }
+
+        // --resume keeps the whole frames an interrupted run left in the output, with --hash only those whose
+        // digest its sidecar recorded, and truncates the output after them. They are counted in the stream
+        // digest and the new sidecar as if just written, and the cursor is moved past them. A Y4M output whose
+        // header differs is started over.
+        bool Resume(selection::Cursor& cursor, const std::string& hdr, size_t frmSz,
+                    const std::unordered_map<size_t, std::string>& recorded, std::ofstream& fsHash, char* buf)
+        {
+            static const std::string marker = std::string(y4m::FRAME_MARKER) + "\n";
+            const size_t recSz = (y4mOut ? marker.size() : 0) + frmSz;
+            IStream fsPrev;
+            fsPrev.open(pathOut, std::ios::in | std::ios::binary);
+            size_t have = 0;
+            if (fsPrev)
+            {
+                fsPrev.seekg(0, std::ios_base::end);
+                auto size = static_cast<std::streamoff>(fsPrev.tellg());
+                fsPrev.seekg(0, std::ios_base::beg);
+                std::string prevHdr(hdr.size(), '\0');
+                fsPrev.read(&prevHdr[0], prevHdr.size());
+                if (fsPrev && prevHdr == hdr && size >= static_cast<std::streamoff>(hdr.size()))
+                {
+                    have = (static_cast<size_t>(size) - hdr.size()) / recSz;
+                }
+            }
+            if (have == 0)
+            {
+                std::error_code ec;
+                std::filesystem::resize_file(pathOut, 0, ec);
+                Write(hdr.data(), hdr.size());
+                return !ec;
+            }
+
+            outBytes = hdr.size();
+            if (!hashFile.empty())
+            {
+                digest::Update(hasherOut, hdr.data(), hdr.size());
+            }
+            std::vector<size_t> index(coreNum);
+            std::vector<std::string> digests(coreNum);
+            size_t done = 0;
+            while (hashFile.empty() && done < have)
+            {
+                // the file size alone tells which frames are kept, nothing is read back
+                const size_t frmNum = cursor.Next(index.data(), std::min(coreNum, have - done));
+                if (frmNum == 0)
+                {
+                    break;
+                }
+                done += frmNum;
+            }
+            while (!hashFile.empty() && done < have)
+            {
+                const auto batch = cursor;
+                const size_t frmNum = cursor.Next(index.data(), std::min(coreNum, have - done));
+                const size_t got = ReadFrames(fsPrev, y4mOut, buf, frmSz, frmNum);
+                std::vector<std::future<void>> tasks;
+                for (size_t i = 0; i < got; i++)
+                {
+                    tasks.push_back(Async([=, &digests]() {
+                        PinWorker(i);
+                        digests[i] = digest::Of(buf + frmSz * i, frmSz);
+                    }));
+                }
+                Wait(tasks);
+
+                size_t valid = 0;
+                for (; valid < got; valid++)
+                {
+                    auto it = recorded.find(index[valid]);
+                    if (it == recorded.end() || it->second != digests[valid])
+                    {
+                        break;
+                    }
+                    if (y4mOut)
+                    {
+                        digest::Update(hasherOut, marker.data(), marker.size());
+                    }
+                    digest::Update(hasherOut, buf + frmSz * valid, frmSz);
+                    fsHash << index[valid] << " " << digests[valid] << "\n";
+                }
+                done += valid;
+                if (frmNum == 0)
+                {
+                    break;
+                }
+                if (valid < frmNum)
+                {
+                    // the rest of the batch is converted again
+                    cursor = batch;
+                    cursor.Next(index.data(), valid);
+                    break;
+                }
+            }
+
+            // what follows the kept frames is written again
+            progress::Add(counters.frames, done);
+            outBytes += recSz * done;
+            std::error_code ec;
+            std::filesystem::resize_file(pathOut, outBytes, ec);
+            fsOut.seekp(outBytes);
+            if (!quiet)
+            {
+                std::cout << "Resuming after " << done << " frames" << std::endl;
+            }
+
+            return !ec && fsOut;
+        }
+
+        // When not even one frame fits in --max-memory, every frame is converted in bands of rows. The rows of a
+        // full width band are contiguous in each plane, so the band is read as a standalone frame of bandH rows
+        // and converted by the same Frame classes, then its planes are written back at their frame offsets. The
+        // last band may be shorter and has its own pair of frames.
+        int ExecuteBands(size_t frmSzIn, size_t frmSzOut, size_t slotSz)
+        {
+            const size_t srcW = cropW != 0 ? cropW : w;
+            const size_t srcH = cropH != 0 ? cropH : h;
+            const size_t alignY = std::max(AlignY(*frmIn[0]), AlignY(*frmOut[0]));
+            // the tail band's frames take at most the Raw planes of one more band
+            const size_t rowCost = slotSz + frmIn[0]->RawSize() + frmOut[0]->RawSize();
+            const size_t maxRows = std::min(h, static_cast<size_t>(static_cast<double>(maxMemory) / rowCost * h));
+            const size_t bandH = maxRows / alignY * alignY;
+            if (bandH == 0)
+            {
+                (toStdout ? std::cerr : std::cout) << "--max-memory " << maxMemory << " does not hold a band of " << alignY
+                                                   << " rows" << std::endl;
+                return -1;
+            }
+            // scaling needs neighbouring rows, hashes need the output in order, bands have a single output and
+            // never hold a whole frame to compare
+            if (Conflicts("--max-memory below one frame",
+                          { { frmScaled[0] != nullptr, "-W/-H" }, { !hashFile.empty(), "--hash" },
+                            { Padded(*frmOut[0]), "padding (-a)" }, { !fanOut.empty(), "several -o" },
+                            { dedupMode != dedup::MODE::OFF, "--dedup" }, { resume, "--resume" } }))
+            {
+                return -1;
+            }
+            const size_t bandNum = (h + bandH - 1) / bandH;
+            const size_t tailH = h - (bandNum - 1) * bandH;
+
+            const size_t frames = y4mIn ? selection::OPEN : CountFrames(fsIn, frmSzIn);
+            selection::Cursor cursor(ranges, every, reverse, limit, frames);
+            if (frames == selection::OPEN || !cursor.Valid())
+            {
+                return -1;
+            }
+
+            // byte ranges of every band in the source and output frames, then the frames become one band each
+            std::vector<std::vector<std::pair<size_t, size_t>>> rangesIn(bandNum);
+            std::vector<std::vector<std::pair<size_t, size_t>>> rangesOut(bandNum);
+            ParseFrameType(frmIn, typeIn.c_str(), "Input", w, bandH);
+            ParseFrameType(frmOut, typeOut.c_str(), "Output", w, bandH);
+            std::vector<frame::Frame*> tailIn(coreNum, nullptr);
+            std::vector<frame::Frame*> tailOut(coreNum, nullptr);
+            ParseFrameType(tailIn.data(), typeIn.c_str(), "Input", w, tailH);
+            ParseFrameType(tailOut.data(), typeOut.c_str(), "Output", w, tailH);
+            for (size_t i = 0; i < coreNum; i++)
+            {
+                frmOut[i]->SetColor(colorSpec);
+                tailOut[i]->SetColor(colorSpec);
+            }
+            try
+            {
+                for (size_t b = 0; b < bandNum; b++)
+                {
+                    auto in = b + 1 == bandNum ? tailIn[0] : frmIn[0];
+                    auto out = b + 1 == bandNum ? tailOut[0] : frmOut[0];
+                    in->SetCrop(srcW, srcH, cropX, cropY + b * bandH);
+                    out->SetCrop(w, h, 0, b * bandH);
+                    rangesIn[b] = in->CropRanges();
+                    rangesOut[b] = out->CropRanges();
+                }
+                for (size_t i = 0; i < coreNum; i++)
+                {
+                    frmIn[i]->SetCrop(srcW, bandH, cropX, 0);
+                }
+                tailIn[0]->SetCrop(srcW, tailH, cropX, 0);
+            }
+            catch (const std::invalid_argument&)
+            {
+                return -1;
+            }
+            frmOut[0]->SetCrop(w, bandH, 0, 0);
+            tailOut[0]->SetCrop(w, tailH, 0, 0);
+            // a crop that does not start on a row of tiles leaves bands that are not frames of their own
+            for (size_t b = 0; b < bandNum; b++)
+            {
+                size_t bytes = 0;
+                for (const auto& range : rangesIn[b])
+                {
+                    bytes += range.second - range.first;
+                }
+                if (bytes != (b + 1 == bandNum ? tailIn[0] : frmIn[0])->FrameSize(false))
+                {
+                    return -1;
+                }
+            }
+
+            const size_t bandSzIn = frmIn[0]->FrameSize(false);
+            const size_t bandSzOut = frmOut[0]->FrameSize(false);
+            const size_t bandSlotSz = bandSzIn + bandSzOut + frmIn[0]->RawSize() + frmOut[0]->RawSize();
+            coreNum = std::max<size_t>(1, std::min({coreNum, bandNum, maxMemory / bandSlotSz}));
+            memPlanned = coreNum * bandSlotSz + (tailH != bandH ? tailIn[0]->RawSize() + tailOut[0]->RawSize() : 0);
+            // the tail band always lands in the same slot
+            const size_t tailSlot = (bandNum - 1) % coreNum;
+
+            auto memIn = pool::Take(buffers, bandSzIn * coreNum);
+            auto memOut = pool::Take(buffers, bandSzOut * coreNum);
+            auto bufIn = memIn.get();
+            auto bufOut = memOut.get();
+            ForEachSlot([=](size_t i) {
+                frmIn[i]->Allocate();
+                if (i == tailSlot)
+                {
+                    tailIn[0]->Allocate();
+                }
+                std::memset(bufIn + bandSzIn * i, 0, bandSzIn);
+                std::memset(bufOut + bandSzOut * i, 0, bandSzOut);
+            });
+
+            if (y4mOut)
+            {
+                y4mHdr.w = w;
+                y4mHdr.h = h;
+                auto hdr = y4m::Format(y4mHdr);
+                Write(hdr.data(), hdr.size());
+            }
+
+            StartProgress(cursor.Count());
+            static const std::string marker = std::string(y4m::FRAME_MARKER) + "\n";
+            size_t idx = 0;
+            while (cursor.Next(&idx, 1) == 1)
+            {
+                if (y4mOut)
+                {
+                    Write(marker.data(), marker.size());
+                }
+                const size_t frmBase = outBytes;
+                for (size_t b = 0; b < bandNum; b += coreNum)
+                {
+                    const size_t num = std::min(coreNum, bandNum - b);
+                    for (size_t i = 0; i < num; i++)
+                    {
+                        size_t pos = 0;
+                        for (const auto& range : rangesIn[b + i])
+                        {
+                            auto size = range.second - range.first;
+                            fsIn.seekg(std::ios_base::beg + frmSzIn * idx + range.first);
+                            fsIn.read(bufIn + bandSzIn * i + pos, size);
+                            if (static_cast<size_t>(fsIn.gcount()) != size)
+                            {
+                                return -1;
+                            }
+                            pos += size;
+                        }
+                        progress::Add(counters.bytesIn, pos);
+                    }
+
+                    std::vector<std::future<void>> tasks(num);
+                    for (size_t i = 0; i < num; i++)
+                    {
+                        bool tail = b + i + 1 == bandNum;
+                        auto in = tail ? tailIn[0] : frmIn[i];
+                        auto out = tail ? tailOut[0] : frmOut[i];
+                        tasks[i] = Async([=]() {
+                            PinWorker(i);
+                            in->ReadFrame(bufIn + bandSzIn * i);
+                            out->MoveFrom(*in);
+                            out->WriteFrame(bufOut + bandSzOut * i);
+                        });
+                    }
+                    Wait(tasks);
+
+                    for (size_t i = 0; i < num; i++)
+                    {
+                        size_t pos = 0;
+                        for (const auto& range : rangesOut[b + i])
+                        {
+                            fsOut.seekp(frmBase + range.first);
+                            fsOut.write(bufOut + bandSzOut * i + pos, range.second - range.first);
+                            pos += range.second - range.first;
+                        }
+                        progress::Add(counters.bytesOut, pos);
+                    }
+                }
+                fsOut.seekp(frmBase + frmSzOut);
+                outBytes = frmBase + frmSzOut;
+                if (!fsOut)
+                {
+                    return -1;
+                }
+                progress::Add(counters.frames, 1);
+            }
+            ReportMemory(bandH);
+
+            return 0;
+        }
+
+        // With --strip every frame is converted in strips of rows sized to the per-core cache, so the Raw planes
+        // of a strip are still cached when the next step reads them. Input strips are unpacked straight from the
+        // frame buffer as crop windows, output strips are packed into a small buffer and copied to their offsets
+        // in the output frame. Chroma is only averaged within a pair of rows, which AlignY strips never split.
+        bool SetStrips(size_t frmSzIn, size_t frmSzOut)
+        {
+            // scaling needs neighbouring rows, padding has no place at the frame offsets, other outputs convert
+            // from the whole frame
+            if (stripRows == 0 || frmScaled[0] || Padded(*frmOut[0]) || !fanOut.empty())
+            {
+                return true;
+            }
+
+            const size_t alignY = std::max(AlignY(*frmIn[0]), AlignY(*frmOut[0]));
+            size_t rows = stripRows;
+            if (rows == AUTO)
+            {
+                // half of the cache for the Raw planes and the packed strip, the rest for the input rows passing by
+                const size_t rowSz = (frmIn[0]->RawSize() + frmOut[0]->RawSize() + frmSzOut) / h;
+                const size_t cache = affinity::CacheSize(2);
+                rows = (cache != 0 ? cache : 1 << 20) / 2 / std::max<size_t>(rowSz, 1);
+            }
+            if (rows / alignY * alignY >= h)
+            {
+                return true;
+            }
+            stripH = std::max<size_t>(rows / alignY, 1) * alignY;
+            const size_t stripNum = (h + stripH - 1) / stripH;
+            const size_t tailH = h - (stripNum - 1) * stripH;
+
+            ParseFrameType(frmIn, typeIn.c_str(), "Input", w, stripH);
+            ParseFrameType(frmOut, typeOut.c_str(), "Output", w, stripH);
+            tailIn.assign(frmIn, frmIn + coreNum);
+            tailOut.assign(frmOut, frmOut + coreNum);
+            if (tailH != stripH)
+            {
+                ParseFrameType(tailIn.data(), typeIn.c_str(), "Input", w, tailH);
+                ParseFrameType(tailOut.data(), typeOut.c_str(), "Output", w, tailH);
+            }
+            for (size_t i = 0; i < coreNum; i++)
+            {
+                frmOut[i]->SetColor(colorSpec);
+                tailOut[i]->SetColor(colorSpec);
+            }
+            stripRanges.resize(stripNum);
+            try
+            {
+                for (size_t s = 0; s < stripNum; s++)
+                {
+                    auto out = s + 1 == stripNum ? tailOut[0] : frmOut[0];
+                    out->SetCrop(w, h, 0, s * stripH);
+                    stripRanges[s] = out->CropRanges();
+                }
+            }
+            catch (const std::invalid_argument&)
+            {
+                return false;
+            }
+            frmOut[0]->SetCrop(w, stripH, 0, 0);
+            tailOut[0]->SetCrop(w, tailH, 0, 0);
+            stripBuf.resize(coreNum);
+
+            if (maxMemory != 0)
+            {
+                memPlanned = coreNum * (frmSzIn + frmSzOut + frmIn[0]->RawSize() + frmOut[0]->RawSize() + frmOut[0]->FrameSize(false)) +
+                    (tailH != stripH ? coreNum * (tailIn[0]->RawSize() + tailOut[0]->RawSize()) : 0);
+            }
+
+            return true;
+        }
+
+        void ConvertStrips(size_t i, const char* in, char* out)
+        {
+            const size_t srcW = cropW != 0 ? cropW : w;
+            const size_t srcH = cropH != 0 ? cropH : h;
+            for (size_t s = 0; s < stripRanges.size(); s++)
+            {
+                bool tail = s + 1 == stripRanges.size();
+                auto strip = tail ? tailIn[i] : frmIn[i];
+                auto packed = tail ? tailOut[i] : frmOut[i];
+                strip->SetCrop(srcW, srcH, cropX, cropY + s * stripH);
+                strip->ReadFrame(in);
+                packed->MoveFrom(*strip);
+                packed->WriteFrame(stripBuf[i].data());
+
+                size_t pos = 0;
+                for (const auto& range : stripRanges[s])
+                {
+                    std::memcpy(out + range.first, stripBuf[i].data() + pos, range.second - range.first);
+                    pos += range.second - range.first;
+                }
+            }
+        }
+
+        // Tiled layouts round rows up to whole tiles, so the padded and unpadded sizes can match with padding
+        static bool Padded(const frame::Frame& frm)
+        {
+            return frm.Width(true) != frm.Width(false) || frm.Height(true) != frm.Height(false);
+        }
+
+        // Rows a strip or band starts on: whole chroma rows, and whole rows of tiles in every plane
+        static size_t AlignY(const frame::Frame& frm)
+        {
+            auto fmt = frm.GetChromaFmt();
+            return (fmt == CHROMA_FORMAT::YUV_420 || fmt == CHROMA_FORMAT::YUV_440 ? 2 : 1) * frm.TileRows();
+        }
+
+        void ReportMemory(size_t bandH) const
+        {
+            if (maxMemory == 0)
+            {
+                return;
+            }
+
+            auto& os = toStdout ? std::cerr : std::cout;
+            os << "peak memory: " << std::fixed << std::setprecision(1) << memPlanned / 1048576.0 << " MiB planned";
+#if defined(__linux__)
+            rusage usage;
+            if (getrusage(RUSAGE_SELF, &usage) == 0)
+            {
+                os << ", " << usage.ru_maxrss / 1024.0 << " MiB resident";
+            }
+#endif
+            os << ", " << coreNum << (bandH != 0 ? " bands of " + std::to_string(bandH) + " rows" : " frames") << " in flight";
+            os << std::endl;
+        }
+
+    private:
+        size_t ReadFrames(char* buf, size_t frmSz, const size_t* index, size_t frmNum)
+        {
+            for (size_t i = 0; i < frmNum;)
+            {
+                // runs of consecutive frames are fetched with one request
+                size_t run = 1;
+                while (i + run < frmNum && index[i + run] == index[i] + run)
+                {
+                    run++;
+                }
+                char* dst = buf + frmSz * i;
+                size_t got = seekIn ? ReadFramesAt(dst, frmSz, index[i], run) : ReadFramesNext(dst, frmSz, index[i], run);
+                if (got != run)
+                {
+                    return i + got;
+                }
+                i += run;
+            }
+
+            return frmNum;
+        }
+
+        size_t ReadFramesAt(char* buf, size_t frmSz, size_t first, size_t frmNum)
+        {
+            if (cropRanges.empty())
+            {
+                fsIn.seekg(std::ios_base::beg + frmSz * first);
+                fsIn.read(buf, frmSz * frmNum);
+                progress::Add(counters.bytesIn, fsIn.gcount());
+                return std::min(static_cast<size_t>(fsIn.gcount()) / frmSz, frmNum);
+            }
+
+            // only the rows crossing the crop window are fetched, each at its offset in the frame buffer
+            for (size_t i = 0; i < frmNum; i++)
+            {
+                for (const auto& range : cropRanges)
+                {
+                    auto size = range.second - range.first;
+                    fsIn.seekg(std::ios_base::beg + frmSz * (first + i) + range.first);
+                    fsIn.read(buf + frmSz * i + range.first, size);
+                    progress::Add(counters.bytesIn, fsIn.gcount());
+                    if (static_cast<size_t>(fsIn.gcount()) != size)
+                    {
+                        return i;
+                    }
+                }
+            }
+
+            return frmNum;
+        }
+
+        // A stream that cannot seek reads past the frames it skips and cannot go back
+        size_t ReadFramesNext(char* buf, size_t frmSz, size_t first, size_t frmNum)
+        {
+            for (; posIn < first; posIn++)
+            {
+                if (ReadFrames(fsIn, y4mIn, buf, frmSz, 1) == 0)
+                {
+                    return 0;
+                }
+                progress::Add(counters.bytesIn, frmSz);
+            }
+            if (posIn != first)
+            {
+                return 0;
+            }
+            size_t got = ReadFrames(fsIn, y4mIn, buf, frmSz, frmNum);
+            posIn += got;
+            progress::Add(counters.bytesIn, frmSz * got);
+
+            return got;
+        }
+
+        static size_t ReadFrames(IStream& fs, bool y4m, char* buf, size_t frmSz, size_t frmNum)
+        {
+            if (!y4m)
+            {
+                fs.read(buf, frmSz * frmNum);
+                return std::min(static_cast<size_t>(fs.gcount()) / frmSz, frmNum);
+            }
+
+            std::string marker;
+            for (size_t i = 0; i < frmNum; i++)
+            {
+                if (!y4m::ReadFrameLine(fs, marker) || marker.compare(0, std::strlen(y4m::FRAME_MARKER), y4m::FRAME_MARKER) != 0)
+                {
+                    return i;
+                }
+                fs.read(buf + frmSz * i, frmSz);
+                if (static_cast<size_t>(fs.gcount()) != frmSz)
+                {
+                    return i;
+                }
+            }
+
+            return frmNum;
+        }
+
+        // Frames in a raw input, selection::OPEN when the stream cannot tell its size (a pipe)
+        static size_t CountFrames(IStream& fs, size_t frmSz)
+        {
+            fs.seekg(0, std::ios_base::end);
+            auto size = static_cast<std::streamoff>(fs.tellg());
+            if (size < 0)
+            {
+                fs.clear();
+                return selection::OPEN;
+            }
+            fs.seekg(0, std::ios_base::beg);
+
+            return static_cast<size_t>(size) / frmSz;
+        }
+
+        bool SkipFrames(IStream& fs, bool y4m, char* buf, size_t frmSz) const
+        {
+            if (!y4m)
+            {
+                return beg == 0 || !!fs.seekg(std::ios_base::beg + frmSz * beg);
+            }
+
+            // a Y4M stream may be a pipe, skip leading frames by reading them
+            for (size_t i = 0; i < beg; i++)
+            {
+                if (ReadFrames(fs, y4m, buf, frmSz, 1) == 0)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool ReadY4MHeader(IStream& fs, std::string& type, bool& isY4M)
+        {
+            if (!IsY4M(type))
+            {
+                return true;
+            }
+
+            std::string line;
+            if (!y4m::ReadLine(fs, line) || !y4m::Parse(line, y4mHdr))
+            {
+                return false;
+            }
+            isY4M = true;
+            w = y4mHdr.w;
+            h = y4mHdr.h;
+            type = y4m::FrameType(y4mHdr.colorspace);
+
+            return true;
+        }
+
+        void PinWorker(size_t i) const
+        {
+            if (!workerCpus.empty())
+            {
+                affinity::Pin(workerCpus[i]);
+            }
+        }
+
+        // A task on a thread of the worker pool when there is one, otherwise on a thread of its own
+        template <typename Fn>
+        std::future<void> Async(Fn&& fn) const
+        {
+            return workers ? workers->Submit(std::forward<Fn>(fn)) : std::async(std::launch::async, std::forward<Fn>(fn));
+        }
+
+        // A pool thread that waits runs queued tasks meanwhile, so nested tasks cannot starve the pool
+        void Wait(std::vector<std::future<void>>& tasks) const
+        {
+            for (auto& task : tasks)
+            {
+                if (workers)
+                {
+                    workers->Wait(task);
+                }
+                else
+                {
+                    task.wait();
+                }
+            }
+        }
+
+        template <typename Fn>
+        void ForEachSlot(Fn fn) const
+        {
+            std::vector<std::future<void>> tasks(coreNum);
+            for (size_t i = 0; i < coreNum; i++)
+            {
+                tasks[i] = Async([=]() {
+                    PinWorker(i);
+                    fn(i);
+                });
+            }
+            Wait(tasks);
+        }
+
+        // Worker i runs on one cpu of the list, or on every cpu of a NUMA node with nodes taken in turn
+        bool PlaceWorkers(size_t threads, const std::vector<int>& cpus, bool numa)
+        {
+            std::vector<std::vector<int>> groups;
+            if (numa)
+            {
+                for (auto node : affinity::Nodes())
+                {
+                    if (!cpus.empty())
+                    {
+                        node.erase(std::remove_if(node.begin(), node.end(), [&](int cpu) {
+                            return std::find(cpus.begin(), cpus.end(), cpu) == cpus.end();
+                        }), node.end());
+                    }
+                    if (!node.empty())
+                    {
+                        groups.push_back(node);
+                    }
+                }
+            }
+            if (groups.empty())
+            {
+                for (int cpu : cpus)
+                {
+                    groups.push_back({cpu});
+                }
+            }
+
+            if (threads == 0)
+            {
+                threads = cpus.empty() ? coreNum : cpus.size();
+            }
+            coreNum = threads;
+            for (size_t i = 0; i < coreNum && !groups.empty(); i++)
+            {
+                workerCpus.push_back(groups[i % groups.size()]);
+            }
+
+            return coreNum > 0;
+        }
+
+        bool SetCrop(frame::Frame** frm)
+        {
+            if (cropW == 0)
+            {
+                return true;
+            }
+
+            // w/h hold the crop size here, cropW/cropH the source size
+            try
+            {
+                for (size_t i = 0; i < coreNum; i++)
+                {
+                    frm[i]->SetCrop(cropW, cropH, cropX, cropY);
+                }
+            }
+            catch (const std::invalid_argument&)
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        static metrics::Plane GetPlane(const frame::Frame& frm, size_t idx)
+        {
+            const auto& raw = frm.GetRaw();
+            if (idx == 0)
+            {
+                return {raw.Y.data(), frm.Width(true), frm.Width(false), frm.Height(false)};
+            }
+
+            return {(idx == 1 ? raw.U : raw.V).data(), frm.WidthChroma(true), frm.WidthChroma(false), frm.HeightChroma(false)};
+        }
+
+        // A piece of split or concat: frames [first, first + num) of one input written at offOut of one output
+        struct Job
+        {
+            std::string type;
+            std::string in;
+            size_t frmSz;
+            size_t first;
+            size_t num;
+            std::string out;
+            size_t offOut;
+            bool copy;
+        };
+
+        // split cuts the input into chunk files of whole frames, concat joins the inputs in order. Every output
+        // offset is known up front, so the pieces run on all workers at once with their own streams, and a
+        // piece that keeps its format is copied by offset instead of converted.
+        int Sequence()
+        {
+            if (y4mOut || cropW != 0 || outW != 0 || outH != 0 || (split && sources.size() != 1))
+            {
+                return -1;
+            }
+            // the frames of every piece would log their padding
+            frame::Frame::EnableLog(false);
+
+            std::unique_ptr<frame::Frame> out(frame::Create(Upper(typeOut), w, h, "Output"));
+            out->SetPadding(alignment, replicate);
+            const size_t frmSzOut = out->FrameSize(true);
+            const bool padded = frmSzOut != out->FrameSize(false);
+
+            std::vector<Job> jobs;
+            size_t offOut = 0;
+            for (const auto& source : sources)
+            {
+                std::unique_ptr<frame::Frame> in(frame::Create(Upper(source.first), w, h, "Input"));
+                IStream fs;
+                fs.open(source.second, std::ios::in | std::ios::binary);
+                const size_t frmSz = in ? in->FrameSize(false) : 0;
+                const size_t frames = in && fs ? CountFrames(fs, frmSz) : selection::OPEN;
+                if (frames == selection::OPEN)
+                {
+                    return -1;
+                }
+
+                const bool copy = Upper(source.first) == Upper(typeOut) && !padded && colorSpec.Identity();
+                // chunks for split, otherwise a share of the input per worker
+                size_t per = split ? (chunkFrames != 0 ? chunkFrames : std::max<size_t>(1, chunkSize / frmSzOut)) :
+                    copy ? frames : (frames + coreNum - 1) / coreNum;
+                per = std::max<size_t>(per, 1);
+                for (size_t first = 0; first < frames; first += per)
+                {
+                    size_t num = std::min(per, frames - first);
+                    if (split)
+                    {
+                        jobs.push_back({ source.first, source.second, frmSz, first, num, ChunkPath(first / per), 0, copy });
+                    }
+                    else
+                    {
+                        jobs.push_back({ source.first, source.second, frmSz, first, num, pathOut, offOut, copy });
+                        offOut += num * frmSzOut;
+                    }
+                }
+            }
+
+            size_t total = 0;
+            for (const auto& job : jobs)
+            {
+                total += job.num;
+            }
+            StartProgress(total);
+            std::vector<char> failed(coreNum, 0);
+            ForEachSlot([&](size_t i) {
+                for (size_t j = i; j < jobs.size(); j += coreNum)
+                {
+                    failed[i] |= !RunJob(jobs[j]);
+                }
+            });
+            if (split && !toStdout && !quiet)
+            {
+                std::cout << jobs.size() << " chunks written" << std::endl;
+            }
+
+            return std::none_of(failed.begin(), failed.end(), [](char f) { return f != 0; }) ? 0 : -1;
+        }
+
+        bool RunJob(const Job& job) const
+        {
+            if (job.out != pathOut)
+            {
+                // a chunk file starts empty
+                OStream fs;
+                fs.open(job.out, std::ios::out | std::ios::binary);
+            }
+            if (job.copy)
+            {
+#if !defined(_WIN32)
+                if (io::CopyRange(job.in, job.frmSz * job.first, job.out, job.offOut, job.frmSz * job.num))
+                {
+                    progress::Add(counters.frames, job.num);
+                    progress::Add(counters.bytesIn, job.frmSz * job.num);
+                    progress::Add(counters.bytesOut, job.frmSz * job.num);
+                    return true;
+                }
+#endif
+            }
+
+            std::unique_ptr<frame::Frame> src(frame::Create(Upper(job.type), w, h, "Input"));
+            std::unique_ptr<frame::Frame> dst(frame::Create(Upper(typeOut), w, h, "Output"));
+            src->SetPadding(alignment, replicate);
+            dst->SetPadding(alignment, replicate);
+            dst->SetColor(colorSpec);
+            src->Allocate();
+            const size_t frmSzOut = dst->FrameSize(true);
+
+            IStream fsA;
+            OStream fsB;
+            fsA.open(job.in, std::ios::in | std::ios::binary);
+            fsB.open(job.out, std::ios::in | std::ios::out | std::ios::binary);
+            fsB.seekp(job.offOut);
+            std::vector<char> bufIn(job.frmSz);
+            std::vector<char> bufOut(frmSzOut);
+            for (size_t f = 0; f < job.num && fsA && fsB; f++)
+            {
+                fsA.seekg(std::ios_base::beg + job.frmSz * (job.first + f));
+                fsA.read(bufIn.data(), job.frmSz);
+                if (static_cast<size_t>(fsA.gcount()) != job.frmSz)
+                {
+                    return false;
+                }
+                progress::Add(counters.bytesIn, job.frmSz);
+                if (job.copy)
+                {
+                    fsB.write(bufIn.data(), job.frmSz);
+                }
+                else
+                {
+                    src->ReadFrame(bufIn.data());
+                    dst->MoveFrom(*src);
+                    dst->WriteFrame(bufOut.data());
+                    fsB.write(bufOut.data(), frmSzOut);
+                }
+                progress::Add(counters.frames, 1);
+                progress::Add(counters.bytesOut, job.copy ? job.frmSz : frmSzOut);
+            }
+
+            return fsA && fsB;
+        }
+
+        // "%d" or "%0<N>d" in the pattern takes the chunk index, otherwise ".<index>" is appended
+        std::string ChunkPath(size_t index) const
+        {
+            auto pos = pathOut.find('%');
+            size_t end = pos == std::string::npos ? pos : pathOut.find_first_not_of("0123456789", pos + 1);
+            if (end == std::string::npos || pathOut[end] != 'd')
+            {
+                return pathOut + "." + std::to_string(index);
+            }
+
+            auto digits = std::to_string(index);
+            size_t width = strtoull(pathOut.c_str() + pos + 1, nullptr, 10);
+            digits.insert(0, width > digits.size() ? width - digits.size() : 0, '0');
+
+            return pathOut.substr(0, pos) + digits + pathOut.substr(end + 1);
+        }
+
+        static std::string Upper(std::string type)
+        {
+            std::transform(type.begin(), type.end(), type.begin(), [](char ch)
+                {
+                    return std::toupper(static_cast<unsigned char>(ch));
+                });
+
+            return type;
+        }
+
+        int Compare()
+        {
+            using Stats = std::array<metrics::PlaneStats, 3>;
+
+            for (size_t i = 0; i < coreNum; i++)
+            {
+                frmIn[i]->Allocate();
+                frmRef[i]->Allocate();
+            }
+
+            const size_t frmSzA = frmIn[0]->FrameSize(false);
+            const size_t frmSzB = frmRef[0]->FrameSize(false);
+            const size_t planeNum = frmIn[0]->GetChromaFmt() == CHROMA_FORMAT::YUV_400 ? 1 : 3;
+            const uint8_t depth = frmIn[0]->GetBitDepth();
+            std::vector<char> bufA(frmSzA * coreNum);
+            std::vector<char> bufB(frmSzB * coreNum);
+
+            if (!SkipFrames(fsIn, y4mIn, bufA.data(), frmSzA) || !SkipFrames(fsRef, y4mRef, bufB.data(), frmSzB))
+            {
+                return -1;
+            }
+
+            Stats total;
+            size_t frmNum2Read = std::min(coreNum, end - beg + 1);
+            size_t frmNumRead = 0;
+            while (frmNum2Read > 0 &&
+                (frmNumRead = std::min(ReadFrames(fsIn, y4mIn, bufA.data(), frmSzA, frmNum2Read),
+                                       ReadFrames(fsRef, y4mRef, bufB.data(), frmSzB, frmNum2Read))) > 0)
+            {
+                // unpack both sides into the Raw layout of the first input, frmOut holds the converted reference
+                std::vector<std::future<void>> tasks(frmNumRead);
+                for (size_t i = 0; i < frmNumRead; i++)
+                {
+                    tasks[i] = Async([=, &bufA, &bufB]() {
+                        PinWorker(i);
+                        frmIn[i]->ReadFrame(bufA.data() + frmSzA * i);
+                        frmRef[i]->ReadFrame(bufB.data() + frmSzB * i);
+                        frmOut[i]->MoveFrom(*frmRef[i]);
+                    });
+                }
+                Wait(tasks);
+
+                // with fewer frames than cores each frame is also split into horizontal bands
+                const size_t bandNum = std::max<size_t>(1, coreNum / frmNumRead);
+                std::vector<Stats> bandStats(frmNumRead * bandNum);
+                tasks.resize(frmNumRead * bandNum);
+                for (size_t t = 0; t < tasks.size(); t++)
+                {
+                    tasks[t] = Async([=, &bandStats]() {
+                        size_t i = t / bandNum;
+                        size_t band = t % bandNum;
+                        for (size_t p = 0; p < planeNum; p++)
+                        {
+                            auto a = GetPlane(*frmIn[i], p);
+                            auto b = GetPlane(*frmOut[i], p);
+                            auto blkH = a.h / 4;
+                            metrics::Distortion(a, b, a.h * band / bandNum, a.h * (band + 1) / bandNum, bandStats[t][p]);
+                            metrics::SSIM(a, b, depth, blkH * band / bandNum, blkH * (band + 1) / bandNum, bandStats[t][p]);
+                        }
+                    });
+                }
+                Wait(tasks);
+
+                for (size_t i = 0; i < frmNumRead; i++)
+                {
+                    Stats frm;
+                    for (size_t band = 0; band < bandNum; band++)
+                    {
+                        for (size_t p = 0; p < planeNum; p++)
+                        {
+                            frm[p].Merge(bandStats[i * bandNum + band][p]);
+                        }
+                    }
+                    std::cout << "frame " << beg + i << ":";
+                    PrintStats(frm, planeNum, depth);
+                    for (size_t p = 0; p < planeNum; p++)
+                    {
+                        total[p].Merge(frm[p]);
+                    }
+                }
+                beg += frmNumRead;
+                frmNum2Read = std::min(coreNum, end - beg + 1);
+            }
+
+            std::cout << "total:";
+            PrintStats(total, planeNum, depth);
 
-            if (ParseArgs(argc, argv) != 0)
+            return 0;
+        }
+
+        // --fields split writes every frame as its top field, then its bottom field, --fields weave puts every two
+        // fields back into a frame; -w/-h give the frame either way. A frame read as an image twice as wide and
+        // half as high holds its top field on the left and its bottom field on the right, so a field is unpacked
+        // straight from the frame through a crop window on that view.
+        int Fields()
+        {
+            const bool weave = fields == FIELDS::WEAVE;
+            const size_t fieldH = h / 2;
+            // the chroma of interlaced 4:2:0 is sampled per field, a field has half the chroma rows of its frame
+            auto halves = [&](const std::string& type) {
+                std::unique_ptr<frame::Frame> frm(frame::Create(Upper(type), w, h, "Frame"));
+                std::unique_ptr<frame::Frame> field(frame::Create(Upper(type), w, fieldH, "Field"));
+                return frm && field && frm->HeightChroma(false) == field->HeightChroma(false) * 2;
+            };
+            if (h % 2 != 0 || !halves(typeIn) || !halves(typeOut))
             {
-                return help ? 0 : -1;
+                return -1;
             }
 
+            std::vector<frame::Frame*> woven(coreNum, nullptr);
+            ParseFrameType(frmIn, typeIn.c_str(), "Field", w, fieldH);
+            ParseFrameType(frmOut, typeOut.c_str(), "Output", w, weave ? h : fieldH);
+            if (weave)
+            {
+                ParseFrameType(woven.data(), typeIn.c_str(), "Woven");
+            }
+            else
+            {
+                // the view only works when every row of the packed frame is stored on its own
+                std::unique_ptr<frame::Frame> frm(frame::Create(Upper(typeIn), w, h, "Frame"));
+                try
+                {
+                    frmIn[0]->SetCrop(2 * w, fieldH, 0, 0);
+                }
+                catch (const std::invalid_argument&)
+                {
+                    return -1;
+                }
+                if (frmIn[0]->TileRows() != 1 || frmIn[0]->FrameSize(false) != frm->FrameSize(false))
+                {
+                    return -1;
+                }
+            }
             for (size_t i = 0; i < coreNum; i++)
             {
                 frmIn[i]->SetPadding(alignment, replicate);
-                frmOut[i]->SetPadding(alignment, replicate);
                 frmIn[i]->Allocate();
+                frmOut[i]->SetPadding(alignment, replicate);
+                frmOut[i]->SetColor(colorSpec);
+                if (weave)
+                {
+                    woven[i]->SetPadding(alignment, replicate);
+                    woven[i]->Allocate();
+                }
             }
 
-            const size_t frmSzIn = frmIn[0]->FrameSize(false);
+            // a record is a frame and its two fields, read and written together by one slot
+            const size_t fieldSzIn = frmIn[0]->FrameSize(false);
             const size_t frmSzOut = frmOut[0]->FrameSize(true);
-            auto bufIn = new char[frmSzIn * coreNum];
-            auto bufOut = new char[frmSzOut * coreNum];
+            const size_t recIn = weave ? fieldSzIn * 2 : fieldSzIn;
+            const size_t recOut = weave ? frmSzOut : frmSzOut * 2;
+            std::vector<char> bufIn(recIn * coreNum);
+            std::vector<char> bufOut(recOut * coreNum);
 
-            if (!fsIn.seekg(std::ios_base::beg + frmSzIn * beg))
+            const size_t frames = CountFrames(fsIn, recIn);
+            if (frames == selection::OPEN)
+            {
+                // a pipe steps over the leading records by reading them
+                for (size_t i = 0; i < beg; i++)
+                {
+                    if (ReadFrames(fsIn, false, bufIn.data(), recIn, 1) == 0)
+                    {
+                        return -1;
+                    }
+                }
+            }
+            else if (!SkipFrames(fsIn, false, bufIn.data(), recIn))
             {
                 return -1;
             }
+            StartProgress(frames == selection::OPEN ? frames : frames > beg ? std::min(frames, end + 1) - beg : 0);
 
             size_t frmNum2Read = std::min(coreNum, end - beg + 1);
-            while (fsIn.read(bufIn, frmSzIn * frmNum2Read), fsIn.gcount())
+            size_t frmNumRead = 0;
+            while (frmNum2Read > 0 && (frmNumRead = ReadFrames(fsIn, false, bufIn.data(), recIn, frmNum2Read)) > 0)
             {
-                size_t frmNumRead = std::min(fsIn.gcount() / frmSzIn, frmNum2Read);
+                progress::Add(counters.bytesIn, recIn * frmNumRead);
                 std::vector<std::future<void>> tasks(frmNumRead);
                 for (size_t i = 0; i < frmNumRead; i++)
                 {
-                    tasks[i] = std::async(
-                        std::launch::async,
-                        [=]() {
-                            frmIn[i]->ReadFrame(bufIn + frmSzIn * i);
-                            frmOut[i]->ConvertFrom(*frmIn[i]);
-                            frmOut[i]->WriteFrame(bufOut + frmSzOut * i);
-                        });
-                }
-                for (size_t i = 0; i < frmNumRead; i++)
-                {
-                    tasks[i].wait();
+                    tasks[i] = Async([=, &bufIn, &bufOut, &woven]() {
+                        PinWorker(i);
+                        const char* in = bufIn.data() + recIn * i;
+                        char* out = bufOut.data() + recOut * i;
+                        for (size_t f = 0; f < 2; f++)
+                        {
+                            if (weave)
+                            {
+                                frmIn[i]->ReadFrame(in + fieldSzIn * f);
+                                woven[i]->WeaveFrom(*frmIn[i], f);
+                            }
+                            else
+                            {
+                                frmIn[i]->SetCrop(2 * w, fieldH, w * f, 0);
+                                frmIn[i]->ReadFrame(in);
+                                frmOut[i]->MoveFrom(*frmIn[i]);
+                                frmOut[i]->WriteFrame(out + frmSzOut * f);
+                            }
+                        }
+                        if (weave)
+                        {
+                            frmOut[i]->MoveFrom(*woven[i]);
+                            frmOut[i]->WriteFrame(out);
+                        }
+                        progress::Add(counters.frames, 1);
+                    });
                 }
-                fsOut.write(bufOut, frmSzOut * frmNumRead);
+                Wait(tasks);
+
+                Write(bufOut.data(), recOut * frmNumRead);
                 beg += frmNumRead;
                 frmNum2Read = std::min(coreNum, end - beg + 1);
             }
@@ -68,71 +1611,235 @@ namespace converter
             return 0;
         }
 
-    private:
-        void PrintHelp() const
+        static void PrintStats(const std::array<metrics::PlaneStats, 3>& stats, size_t planeNum, uint8_t depth)
+        {
+            static const char* planeName[] = { "Y", "U", "V" };
+            auto flags = std::cout.flags();
+            std::cout << std::fixed << std::setprecision(4) << " PSNR";
+            for (size_t p = 0; p < planeNum; p++)
+            {
+                std::cout << " " << planeName[p] << " " << stats[p].PSNR(depth);
+            }
+            std::cout << " SSIM";
+            for (size_t p = 0; p < planeNum; p++)
+            {
+                std::cout << " " << planeName[p] << " " << stats[p].SSIM();
+            }
+            std::cout << " MAXDIFF";
+            for (size_t p = 0; p < planeNum; p++)
+            {
+                std::cout << " " << planeName[p] << " " << stats[p].maxDiff;
+            }
+            std::cout << std::endl;
+            std::cout.flags(flags);
+        }
+
+        // --progress json reports on stderr, stdout may be the output
+        void StartProgress(size_t total)
         {
-            std::cout << "Usage: yuv_tools -w <width> -h <height> -i:<format> <input> -o:<format> <output> "
-                         "[-a|--align <value>] [-r|--replicate <0|1>] [-n:beg <index>] [-n:end <index>] [-n <count>] [--help]\n";
+            if (progressJson)
+            {
+                reporter.reset(new progress::Reporter(counters, total == selection::OPEN ? 0 : total, std::cerr));
+            }
         }
 
-        void ParseFrameType(frame::Frame** frm, const char* type, const char* name)
+        void WriteFrames(const char* buf, size_t frmSz, size_t frmNum)
+        {
+            if (!y4mOut)
+            {
+                Write(buf, frmSz * frmNum);
+                return;
+            }
+
+            static const std::string marker = std::string(y4m::FRAME_MARKER) + "\n";
+            for (size_t i = 0; i < frmNum; i++)
+            {
+                Write(marker.data(), marker.size());
+                Write(buf + frmSz * i, frmSz);
+            }
+        }
+
+        // The other outputs are plain streams, the hash and the memory report follow the first one
+        void WriteFrames(Output& out, size_t first, size_t frmNum)
+        {
+            const char* buf = out.buf.get() + out.frmSz * first;
+            progress::Add(counters.bytesOut, out.frmSz * frmNum);
+            if (!out.y4m)
+            {
+                out.fs.write(buf, out.frmSz * frmNum);
+                return;
+            }
+
+            static const std::string marker = std::string(y4m::FRAME_MARKER) + "\n";
+            for (size_t i = 0; i < frmNum; i++)
+            {
+                out.fs.write(marker.data(), marker.size());
+                out.fs.write(buf + out.frmSz * i, out.frmSz);
+            }
+        }
+
+        void Write(const char* buf, size_t size)
+        {
+            fsOut.write(buf, size);
+            outBytes += size;
+            progress::Add(counters.bytesOut, size);
+            if (!hashFile.empty())
+            {
+                digest::Update(hasherOut, buf, size);
+            }
+        }
+
+        // -o:y4m[:<colorspace>] picks the frame type of the colorspace, the input's by default
+        void ParseY4MOut(std::string& type, bool& isY4M, y4m::Header& hdr) const
         {
-            std::string tp(type);
-            std::transform(tp.begin(), tp.end(), tp.begin(), [](char ch)
+            if (!IsY4M(type))
+            {
+                return;
+            }
+
+            isY4M = true;
+            hdr.colorspace = type.size() > 4 ? type.substr(4) :
+                y4m::ColorSpace(frmIn[0]->GetChromaFmt(), frmIn[0]->GetBitDepth());
+            std::transform(hdr.colorspace.begin(), hdr.colorspace.end(), hdr.colorspace.begin(), [](char ch)
                 {
-                    return std::toupper(static_cast<unsigned char>(ch));
+                    return std::tolower(static_cast<unsigned char>(ch));
                 });
+            type = y4m::FrameType(hdr.colorspace);
+        }
+
+        static bool IsY4M(const std::string& type)
+        {
+            return type.size() >= 3 && (type.compare(0, 3, "y4m") == 0 || type.compare(0, 3, "Y4M") == 0) &&
+                (type.size() == 3 || type[3] == ':');
+        }
+
+        static const char* StreamPath(const char* path, bool in)
+        {
+#if !defined(_WIN32)
+            // "-" reads from stdin or writes to stdout, so the tool can sit in a pipe
+            if (std::strcmp(path, "-") == 0)
+            {
+                return in ? "/dev/stdin" : "/dev/stdout";
+            }
+#endif
+            return path;
+        }
+
+        // A shared memory ring (io::ShmFile) streams like a pipe, there is nothing to read back from it
+        static bool IsRing(const std::string& path)
+        {
+            return path.compare(0, 4, "shm:") == 0;
+        }
+
+        // An option that only works without some others names every one it was given with
+        bool Conflicts(const char* option, std::initializer_list<std::pair<bool, const char*>> others) const
+        {
+            auto& os = toStdout ? std::cerr : std::cout;
+            bool clash = false;
+            for (auto& other : others)
+            {
+                if (other.first)
+                {
+                    os << option << " cannot be used with " << other.second << std::endl;
+                    clash = true;
+                }
+            }
 
-            using namespace frame;
-#define CHECK_TYPE_AND_CREATE(T) else if (#T == tp)  for (size_t i = 0; i < coreNum; i++) frm[i] = CREATE_FRAME(T, w, h, name)
+            return clash;
+        }
+
+        void PrintHelp() const
+        {
+            std::cout << "Usage: yuv_tools -w <width> -h <height> -i:<format> <input> -o:<format> <output> [-o:<format> <output> ...] "
+                         "[-a|--align <value>] [-r|--replicate <0|1>] [-n:beg <index>] [-n:end <index>] [-n <count>] "
+                         "[-n:list <i>,<j>-<k>,...] [--every <N>] [--reverse] [--crop <x>,<y>,<w>,<h>] [-W <output width>] [-H <output height>] [--scale <bilinear|area|bicubic>] "
+                         "[--range <limited|full>:<limited|full>] [--matrix <601|709|2020>:<601|709|2020>] [--fields <split|weave>] "
+                         "[--hash <sidecar> [--hash:in]] [--resume] [--dedup <drop|reuse> [--dedup-threshold <mean abs diff>] [--dedup-map <file>]] "
+                         "[--io <posix|direct|uring>] [--drop-cache] [--progress json] "
+                         "[--threads <N>] [--cpus <list>] [--numa] [--max-memory <bytes>[K|M|G]] [--strip <rows|auto>] [-q|--quiet] [--help]\n"
+                         "       yuv_tools compare -w <width> -h <height> -i:<format> <input> -i:<format> <reference> "
+                         "[-n:beg <index>] [-n:end <index>] [-n <count>]\n"
+                         "       yuv_tools split -w <width> -h <height> -i:<format> <input> -o:<format> <chunk pattern> "
+                         "<--chunk-frames <N>|--chunk-size <bytes>[K|M|G]> [--threads <N>] [--progress json]\n"
+                         "       yuv_tools concat -w <width> -h <height> -i:<format> <input> [-i:<format> <input> ...] -o:<format> <output> "
+                         "[--threads <N>] [--progress json]\n"
+                         "       yuv_tools serve <socket> [--jobs <N>] [--threads <N>]\n"
+                         "       <format> may be y4m for a YUV4MPEG2 stream, the output colorspace defaults to the input one "
+                         "or is given as -o:y4m:<colorspace>, <input>/<output> may be - for stdin/stdout "
+                         "or shm:<name> for a shared memory ring\n";
+        }
+
+        void ParseFrameType(frame::Frame** frm, const char* type, const char* name)
+        {
+            ParseFrameType(frm, type, name, w, h);
+        }
 
+        void ParseFrameType(frame::Frame** frm, const char* type, const char* name, size_t width, size_t height)
+        {
+            const auto tp = Upper(type);
             if (tp.empty())
             {
                 return;
             }
-            CHECK_TYPE_AND_CREATE(I400);
-            CHECK_TYPE_AND_CREATE(I420);
-            CHECK_TYPE_AND_CREATE(NV12);
-            CHECK_TYPE_AND_CREATE(P010);
-            CHECK_TYPE_AND_CREATE(P012);
-            CHECK_TYPE_AND_CREATE(P016);
-            CHECK_TYPE_AND_CREATE(NV21);
-            CHECK_TYPE_AND_CREATE(I422);
-            CHECK_TYPE_AND_CREATE(NV16);
-            CHECK_TYPE_AND_CREATE(P210);
-            CHECK_TYPE_AND_CREATE(P216);
-            CHECK_TYPE_AND_CREATE(YUYV);
-            CHECK_TYPE_AND_CREATE(YUY2);
-            CHECK_TYPE_AND_CREATE(UYVY);
-            CHECK_TYPE_AND_CREATE(Y210);
-            CHECK_TYPE_AND_CREATE(Y216);
-            CHECK_TYPE_AND_CREATE(I440);
-            CHECK_TYPE_AND_CREATE(I444);
-            CHECK_TYPE_AND_CREATE(YUV444P10LE);
-            CHECK_TYPE_AND_CREATE(NV42);
-            CHECK_TYPE_AND_CREATE(VUYX);
-            CHECK_TYPE_AND_CREATE(AYUV);
-            CHECK_TYPE_AND_CREATE(Y410);
-            CHECK_TYPE_AND_CREATE(Y416);
-            CHECK_TYPE_AND_CREATE(NV24);
-            CHECK_TYPE_AND_CREATE(P410);
-            CHECK_TYPE_AND_CREATE(P416);
-
-#undef CHECK_TYPE_AND_CREATE
+            for (size_t i = 0; i < coreNum; i++)
+            {
+                frm[i] = frame::Create(tp, width, height, name);
+                ownedFrames.emplace_back(frm[i]);
+            }
+        }
+
+        // <bytes>[K|M|G]
+        static size_t ParseBytes(const char* arg)
+        {
+            char* unit = nullptr;
+            size_t bytes = strtoull(arg, &unit, 10);
+            switch (std::toupper(static_cast<unsigned char>(*unit)))
+            {
+            case 'G':
+                bytes <<= 10;
+                // fall through
+            case 'M':
+                bytes <<= 10;
+                // fall through
+            case 'K':
+                bytes <<= 10;
+                break;
+            default:
+                break;
+            }
+
+            return bytes;
         }
 
         int ParseArgs(int argc, const char* const * argv)
         {
-            size_t n = -1;
+            size_t n = NO_COUNT;
+            size_t threads = 0;
+            std::vector<int> cpus;
+            bool numa = false;
             if (argc == 0)
             {
                 help = true;
                 PrintHelp();
                 return -1;
             }
+            // the output is opened as it is parsed, truncated unless resumed
+            resume = std::any_of(argv, argv + argc, [](const char* arg) { return std::strcmp(arg, "--resume") == 0; });
             for (auto i = 0; i < argc; ++i)
             {
-                if (std::strcmp(argv[i], "--help") == 0)
+                if (i == 0 && std::strcmp(argv[i], "compare") == 0)
+                {
+                    compare = true;
+                }
+                else if (i == 0 && std::strcmp(argv[i], "split") == 0)
+                {
+                    split = true;
+                }
+                else if (i == 0 && std::strcmp(argv[i], "concat") == 0)
+                {
+                    concat = true;
+                }
+                else if (std::strcmp(argv[i], "--help") == 0)
                 {
                     help = true;
                     PrintHelp();
@@ -148,15 +1855,46 @@ namespace converter
                 {
                     h = strtoull(argv[++i], nullptr, 10);
                 }
+                else if (std::strncmp(argv[i], "-i:", 2) == 0 && compare && !typeIn.empty())
+                {
+                    typeRef = argv[i] + 3;
+                    fsRef.open(StreamPath(argv[++i], true), std::ios::in | std::ios::binary);
+                }
+                else if (std::strncmp(argv[i], "-i:", 2) == 0 && concat && !typeIn.empty())
+                {
+                    sources.emplace_back(argv[i] + 3, argv[i + 1]);
+                    ++i;
+                }
                 else if (std::strncmp(argv[i], "-i:", 2) == 0)
                 {
-                    ParseFrameType(frmIn, argv[i] + 3, "Input");
-                    fsIn.open(argv[++i], std::ios::in | std::ios::binary);
+                    typeIn = argv[i] + 3;
+                    sources.emplace_back(typeIn, argv[i + 1]);
+                    fsIn.open(StreamPath(argv[++i], true), std::ios::in | std::ios::binary);
+                }
+                else if (std::strncmp(argv[i], "-o:", 2) == 0 && split)
+                {
+                    // a pattern of chunk names, the chunks are created when written
+                    typeOut = argv[i] + 3;
+                    pathOut = argv[++i];
+                }
+                else if (std::strncmp(argv[i], "-o:", 2) == 0 && !typeOut.empty())
+                {
+                    fanOut.emplace_back(new Output);
+                    fanOut.back()->type = argv[i] + 3;
+                    toStdout = toStdout || std::strcmp(argv[++i], "-") == 0;
+                    fanOut.back()->fs.open(StreamPath(argv[i], false), std::ios::out | std::ios::binary);
                 }
                 else if (std::strncmp(argv[i], "-o:", 2) == 0)
                 {
-                    ParseFrameType(frmOut, argv[i] + 3, "Output");
-                    fsOut.open(argv[++i], std::ios::out | std::ios::binary);
+                    typeOut = argv[i] + 3;
+                    toStdout = toStdout || std::strcmp(argv[++i], "-") == 0;
+                    pathOut = argv[i];
+                    // --resume updates the output in place, a missing one is created
+                    fsOut.open(StreamPath(argv[i], false), std::ios::out | std::ios::binary | (resume ? std::ios::in : std::ios::openmode()));
+                    if (resume && !fsOut)
+                    {
+                        fsOut.open(StreamPath(argv[i], false), std::ios::out | std::ios::binary);
+                    }
                 }
                 else if (std::strcmp(argv[i], "-a") == 0 ||
                     std::strcmp(argv[i], "--align") == 0)
@@ -180,36 +1918,447 @@ namespace converter
                 {
                     n = strtoull(argv[++i], nullptr, 10);
                 }
+                else if (std::strcmp(argv[i], "-n:list") == 0)
+                {
+                    if (!selection::Parse(argv[++i], ranges))
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--every") == 0)
+                {
+                    every = strtoull(argv[++i], nullptr, 10);
+                }
+                else if (std::strcmp(argv[i], "--reverse") == 0)
+                {
+                    reverse = true;
+                }
+                else if (std::strcmp(argv[i], "--io") == 0)
+                {
+                    // the backend itself is the IStream/OStream type the caller instantiated
+                    ioBackend = argv[++i];
+                    if (ioBackend != "posix" && ioBackend != "direct" && ioBackend != "uring")
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "-q") == 0 || std::strcmp(argv[i], "--quiet") == 0)
+                {
+                    quiet = true;
+                }
+                else if (std::strncmp(argv[i], "--progress", 10) == 0)
+                {
+                    // --progress json or --progress=json, the only format so far, lines an orchestrator can parse
+                    const char* format = argv[i][10] == '=' ? argv[i] + 11 : argv[i][10] == '\0' && i + 1 < argc ? argv[++i] : "";
+                    progressJson = std::strcmp(format, "json") == 0;
+                    if (!progressJson)
+                    {
+                        std::cerr << "--progress takes json, not " << argv[i] << std::endl;
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--resume") == 0)
+                {
+                    // picked up before the output was opened
+                }
+                else if (std::strcmp(argv[i], "--drop-cache") == 0)
+                {
+                    // set on the file backend by the caller
+                }
+                else if (std::strcmp(argv[i], "-W") == 0)
+                {
+                    outW = strtoull(argv[++i], nullptr, 10);
+                }
+                else if (std::strcmp(argv[i], "-H") == 0)
+                {
+                    outH = strtoull(argv[++i], nullptr, 10);
+                }
+                else if (std::strcmp(argv[i], "--scale") == 0)
+                {
+                    ++i;
+                    if (std::strcmp(argv[i], "bilinear") == 0)
+                    {
+                        filter = scaler::FILTER::BILINEAR;
+                    }
+                    else if (std::strcmp(argv[i], "area") == 0)
+                    {
+                        filter = scaler::FILTER::AREA;
+                    }
+                    else if (std::strcmp(argv[i], "bicubic") == 0)
+                    {
+                        filter = scaler::FILTER::BICUBIC;
+                    }
+                    else
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--range") == 0)
+                {
+                    if (!color::ParseRange(argv[++i], colorSpec))
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--matrix") == 0)
+                {
+                    if (!color::ParseMatrix(argv[++i], colorSpec))
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--fields") == 0)
+                {
+                    ++i;
+                    if (std::strcmp(argv[i], "split") == 0)
+                    {
+                        fields = FIELDS::SPLIT;
+                    }
+                    else if (std::strcmp(argv[i], "weave") == 0)
+                    {
+                        fields = FIELDS::WEAVE;
+                    }
+                    else
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--crop") == 0)
+                {
+                    char* next = nullptr;
+                    cropX = strtoull(argv[++i], &next, 10);
+                    cropY = strtoull(next + (*next == ','), &next, 10);
+                    cropW = strtoull(next + (*next == ','), &next, 10);
+                    cropH = strtoull(next + (*next == ','), &next, 10);
+                    if (cropW == 0 || cropH == 0)
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--hash") == 0)
+                {
+                    hashFile = argv[++i];
+                }
+                else if (std::strcmp(argv[i], "--hash:in") == 0)
+                {
+                    hashIn = true;
+                }
+                else if (std::strcmp(argv[i], "--dedup") == 0)
+                {
+                    ++i;
+                    if (std::strcmp(argv[i], "drop") == 0)
+                    {
+                        dedupMode = dedup::MODE::DROP;
+                    }
+                    else if (std::strcmp(argv[i], "reuse") == 0)
+                    {
+                        dedupMode = dedup::MODE::REUSE;
+                    }
+                    else
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--dedup-threshold") == 0)
+                {
+                    char* endp = nullptr;
+                    dedupThreshold = strtod(argv[++i], &endp);
+                    if (endp == argv[i] || dedupThreshold < 0)
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--dedup-map") == 0)
+                {
+                    dedupMap = argv[++i];
+                }
+                else if (std::strcmp(argv[i], "--threads") == 0)
+                {
+                    threads = strtoull(argv[++i], nullptr, 10);
+                    if (threads == 0)
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--cpus") == 0)
+                {
+                    if (!affinity::ParseCpus(argv[++i], cpus))
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--numa") == 0)
+                {
+                    numa = true;
+                }
+                else if (std::strcmp(argv[i], "--strip") == 0)
+                {
+                    ++i;
+                    stripRows = std::strcmp(argv[i], "auto") == 0 ? AUTO : strtoull(argv[i], nullptr, 10);
+                    if (stripRows == 0)
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--max-memory") == 0)
+                {
+                    maxMemory = ParseBytes(argv[++i]);
+                    if (maxMemory == 0)
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--chunk-frames") == 0)
+                {
+                    chunkFrames = strtoull(argv[++i], nullptr, 10);
+                    if (chunkFrames == 0)
+                    {
+                        return -1;
+                    }
+                }
+                else if (std::strcmp(argv[i], "--chunk-size") == 0)
+                {
+                    chunkSize = ParseBytes(argv[++i]);
+                    if (chunkSize == 0)
+                    {
+                        return -1;
+                    }
+                }
+            }
+
+            // one slot of frames and buffers per worker
+            if (!PlaceWorkers(threads, cpus, numa))
+            {
+                return -1;
+            }
+            frmIn = new frame::Frame * [coreNum] {nullptr};
+            frmOut = new frame::Frame * [coreNum] {nullptr};
+            frmRef = new frame::Frame * [coreNum] {nullptr};
+            frmScaled = new frame::Frame * [coreNum] {nullptr};
+
+            if (typeIn.empty() || !fsIn || (compare ? typeRef.empty() || !fsRef : typeOut.empty() || (split ? pathOut.empty() : !fsOut)) ||
+                (split && (chunkFrames == 0) == (chunkSize == 0)))
+            {
+                return -1;
+            }
+
+            // frames are created once all options are known, a Y4M header overrides -w/-h
+            if (!ReadY4MHeader(fsIn, typeIn, y4mIn))
+            {
+                return -1;
+            }
+            if (cropW != 0)
+            {
+                std::swap(w, cropW);
+                std::swap(h, cropH);
+            }
+            ParseFrameType(frmIn, typeIn.c_str(), "Input");
+            if (!frmIn[0] || !SetCrop(frmIn))
+            {
+                return -1;
+            }
+            for (const auto& range : cropW != 0 ? frmIn[0]->CropRanges() : decltype(cropRanges)())
+            {
+                if (!cropRanges.empty() && cropRanges.back().second == range.first)
+                {
+                    cropRanges.back().second = range.second;
+                }
+                else
+                {
+                    cropRanges.push_back(range);
+                }
+            }
+
+            if (compare)
+            {
+                // the reference is compared in the Raw layout of the first input
+                size_t wIn = w;
+                size_t hIn = h;
+                if (!ReadY4MHeader(fsRef, typeRef, y4mRef))
+                {
+                    return -1;
+                }
+                if (y4mRef && (w != (cropW != 0 ? cropW : wIn) || h != (cropH != 0 ? cropH : hIn)))
+                {
+                    return -1;
+                }
+                w = wIn;
+                h = hIn;
+                ParseFrameType(frmRef, typeRef.c_str(), "Reference");
+                typeOut = typeIn;
+                if (!frmRef[0] || !SetCrop(frmRef))
+                {
+                    return -1;
+                }
+            }
+
+            // every output starts from the input's Y4M parameters
+            for (auto& out : fanOut)
+            {
+                out->hdr = y4mHdr;
+                ParseY4MOut(out->type, out->y4m, out->hdr);
+            }
+            ParseY4MOut(typeOut, y4mOut, y4mHdr);
+
+            if (!compare && (outW != 0 || outH != 0))
+            {
+                outW = outW != 0 ? outW : w;
+                outH = outH != 0 ? outH : h;
+                ParseFrameType(frmScaled, typeIn.c_str(), "Scaled", outW, outH);
+                w = outW;
+                h = outH;
+            }
+            ParseFrameType(frmOut, typeOut.c_str(), "Output");
+            for (auto& out : fanOut)
+            {
+                out->frm.resize(coreNum, nullptr);
+                ParseFrameType(out->frm.data(), out->type.c_str(), "Output");
+                if (!out->frm[0] || !out->fs || compare)
+                {
+                    return -1;
+                }
+            }
+
+            if (!frmOut[0] || beg > end || n == 0 || (end != NO_END && n != NO_COUNT) || (hashIn && hashFile.empty()) ||
+                (dedupMode == dedup::MODE::OFF && (dedupThreshold > 0 || !dedupMap.empty())) ||
+                (compare && !colorSpec.Identity()) ||
+                every == 0 || (!ranges.empty() && (beg != 0 || end != NO_END)))
+            {
+                return -1;
             }
 
-            if (!frmIn[0] || !frmOut[0] || !fsIn || !fsOut || beg > end ||
-                n == 0 || (end != -2 && n != -1))
+            if (fields != FIELDS::OFF &&
+                Conflicts("--fields", { { compare, "compare" }, { split, "split" }, { concat, "concat" },
+                                        { y4mIn || y4mOut, "Y4M streams" }, { !fanOut.empty(), "several -o" },
+                                        { cropW != 0, "--crop" }, { outW != 0 || outH != 0, "-W/-H" },
+                                        { !hashFile.empty(), "--hash" }, { dedupMode != dedup::MODE::OFF, "--dedup" },
+                                        { resume, "--resume" }, { !ranges.empty(), "-n:list" }, { every != 1, "--every" },
+                                        { reverse, "--reverse" }, { maxMemory != 0, "--max-memory" },
+                                        { stripRows != 0, "--strip" } }))
+            {
+                return -1;
+            }
+            // a shared memory ring is its own backend, the files next to it could only be plain ones
+            const bool ring = std::any_of(argv, argv + argc, [](const char* arg) { return IsRing(arg); });
+            if (ioBackend != "posix" && Conflicts(("--io " + ioBackend).c_str(), { { ring, "a shared memory ring" } }))
+            {
+                return -1;
+            }
+            // compare walks both inputs in step from -n:beg
+            if (compare &&
+                Conflicts("compare", { { !ranges.empty(), "-n:list" }, { every != 1, "--every" }, { reverse, "--reverse" } }))
+            {
+                return -1;
+            }
+            if (resume &&
+                Conflicts("--resume", { { toStdout, "stdout" }, { IsRing(pathOut), "a shared memory ring" },
+                                        { compare, "compare" }, { split, "split" }, { concat, "concat" },
+                                        { !fanOut.empty(), "several -o" }, { hashIn, "--hash:in" },
+                                        { dedupMode == dedup::MODE::DROP, "--dedup drop" }, { !dedupMap.empty(), "--dedup-map" } }))
             {
                 return -1;
             }
 
-            if (n != -1)
+            if (!ranges.empty())
             {
-                end = beg + n - 1;
+                // a list is capped by -n instead of being bounded by -n:beg/-n:end
+                limit = n;
+            }
+            else
+            {
+                if (n != NO_COUNT)
+                {
+                    end = beg + n - 1;
+                }
+                ranges.push_back({beg, end + 1});
             }
 
-            frame::Frame::EnableLog(true);
+            // logging would corrupt a stream written to stdout
+            frame::Frame::EnableLog(!toStdout && !quiet);
 
             return 0;
         }
 
     private:
-        const size_t coreNum = std::thread::hardware_concurrency();
+        size_t coreNum = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::vector<int>> workerCpus;
+        size_t maxMemory = 0;
+        size_t memPlanned = 0;
+        size_t outBytes = 0;
+        bool resume = false;
+        bool progressJson = false;
+        std::string ioBackend = "posix";
+        bool quiet = false;
+        // updated by the const jobs of split and concat too
+        mutable progress::Counters counters;
+        std::unique_ptr<progress::Reporter> reporter;
+        pool::Workers* workers = nullptr;
+        pool::Buffers* buffers = nullptr;
+        static constexpr size_t AUTO = static_cast<size_t>(-1);
+        // -n and -n:end when not given, an open end runs to the last frame since end + 1 is selection::OPEN
+        static constexpr size_t NO_COUNT = selection::OPEN;
+        static constexpr size_t NO_END = selection::OPEN - 1;
+        size_t stripRows = 0;
+        size_t stripH = 0;
+        std::vector<std::vector<std::pair<size_t, size_t>>> stripRanges;
+        std::vector<frame::Frame*> tailIn;
+        std::vector<frame::Frame*> tailOut;
+        std::vector<std::vector<char>> stripBuf;
         size_t w = 0;
         size_t h = 0;
+        // every frame ever created, the slot arrays and strip/band frames only point into it
+        std::vector<std::unique_ptr<frame::Frame>> ownedFrames;
         frame::Frame** frmIn = nullptr;
         frame::Frame** frmOut = nullptr;
+        frame::Frame** frmRef = nullptr;
+        frame::Frame** frmScaled = nullptr;
         IStream fsIn;
+        IStream fsRef;
         OStream fsOut;
+        std::vector<std::unique_ptr<Output>> fanOut;
+        std::string pathOut;
+        std::vector<std::pair<std::string, std::string>> sources;
+        bool split = false;
+        bool concat = false;
+        size_t chunkFrames = 0;
+        size_t chunkSize = 0;
+        std::string typeIn;
+        std::string typeOut;
+        bool toStdout = false;
+        y4m::Header y4mHdr;
+        bool y4mIn = false;
+        bool y4mOut = false;
+        std::string hashFile;
+        bool hashIn = false;
+        dedup::MODE dedupMode = dedup::MODE::OFF;
+        double dedupThreshold = 0;
+        std::string dedupMap;
+        Kept kept;
+        digest::Sha256 hasherIn;
+        digest::Sha256 hasherOut;
         size_t alignment = 2;
         bool replicate = false;
         size_t beg = 0;
-        size_t end = -2;
+        size_t end = NO_END;
+        std::vector<selection::Range> ranges;
+        size_t every = 1;
+        bool reverse = false;
+        size_t limit = NO_COUNT;
+        bool seekIn = false;
+        size_t posIn = 0;
+        size_t cropX = 0;
+        size_t cropY = 0;
+        size_t cropW = 0;
+        size_t cropH = 0;
+        std::vector<std::pair<size_t, size_t>> cropRanges;
+        size_t outW = 0;
+        size_t outH = 0;
+        scaler::FILTER filter = scaler::FILTER::BICUBIC;
+        color::Spec colorSpec;
+        FIELDS fields = FIELDS::OFF;
         bool help = false;
+        bool compare = false;
+        std::string typeRef;
+        bool y4mRef = false;
     };
 }
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace selection
+{
+    // Half-open range of frame indices, stop is -1 while the end of the input is unknown
+    struct Range
+    {
+        size_t start;
+        size_t stop;
+    };
+
+    static constexpr size_t OPEN = static_cast<size_t>(-1);
+
+    // Parses "0,5,10-20,100-" (inclusive ranges, a trailing '-' runs to the end of the input)
+    inline bool Parse(const char* list, std::vector<Range>& ranges)
+    {
+        std::string spec(list);
+        size_t pos = 0;
+        while (pos <= spec.size())
+        {
+            auto next = std::min(spec.find(',', pos), spec.size());
+            auto item = spec.substr(pos, next - pos);
+            auto dash = item.find('-');
+            char* endp = nullptr;
+            auto first = strtoull(item.c_str(), &endp, 10);
+            if (item.empty() || endp == item.c_str())
+            {
+                return false;
+            }
+            if (dash == std::string::npos)
+            {
+                ranges.push_back({first, first + 1});
+            }
+            else if (dash + 1 == item.size())
+            {
+                ranges.push_back({first, OPEN});
+            }
+            else
+            {
+                auto last = strtoull(item.c_str() + dash + 1, nullptr, 10);
+                if (last < first)
+                {
+                    return false;
+                }
+                ranges.push_back({first, last + 1});
+            }
+            pos = next + 1;
+        }
+
+        return !ranges.empty();
+    }
+
+    // Walks the selected frames in output order: the ranges as given (or reversed), every step-th frame of them,
+    // up to limit frames. Indices are produced arithmetically, unselected frames cost nothing.
+    class Cursor
+    {
+    public:
+        Cursor(std::vector<Range> ranges, size_t step, bool reverse, size_t limit, size_t frames)
+            : m_step(std::max<size_t>(step, 1)), m_reverse(reverse), m_limit(limit)
+        {
+            for (auto& range : ranges)
+            {
+                range.stop = std::min(range.stop, frames);
+                if (range.start < range.stop)
+                {
+                    m_ranges.push_back(range);
+                }
+            }
+            if (m_reverse)
+            {
+                std::reverse(m_ranges.begin(), m_ranges.end());
+            }
+        }
+
+        // A reversed walk has to know where every range ends
+        bool Valid() const
+        {
+            return !m_reverse || std::none_of(m_ranges.begin(), m_ranges.end(), [](const Range& r) { return r.stop == OPEN; });
+        }
+
+        // Fills up to max next indices, returns how many
+        size_t Next(size_t* index, size_t max)
+        {
+            size_t n = 0;
+            while (n < max && m_limit > 0 && m_range < m_ranges.size())
+            {
+                const auto& range = m_ranges[m_range];
+                size_t len = range.stop - range.start;
+                if (m_off + m_skip >= len)
+                {
+                    m_skip -= len - m_off;
+                    m_off = 0;
+                    m_range++;
+                    continue;
+                }
+                m_off += m_skip;
+                index[n++] = m_reverse ? range.stop - 1 - m_off : range.start + m_off;
+                m_off++;
+                m_skip = m_step - 1;
+                m_limit--;
+            }
+
+            return n;
+        }
+
+        // How many indices Next has left to return, OPEN when a range has no end and no limit caps it
+        size_t Count() const
+        {
+            size_t n = 0;
+            size_t off = m_off;
+            size_t skip = m_skip;
+            for (size_t r = m_range; r < m_ranges.size() && n < m_limit; r++)
+            {
+                const auto& range = m_ranges[r];
+                if (range.stop == OPEN)
+                {
+                    return m_limit;
+                }
+                size_t len = range.stop - range.start;
+                if (off + skip >= len)
+                {
+                    skip -= len - off;
+                    off = 0;
+                    continue;
+                }
+                size_t first = off + skip;
+                size_t num = (len - 1 - first) / m_step + 1;
+                n += num;
+                // the index after the last one taken here, counted from the end of the range
+                skip = first + (num - 1) * m_step + m_step - len;
+                off = 0;
+            }
+
+            return std::min(n, m_limit);
+        }
+
+    private:
+        std::vector<Range> m_ranges;
+        size_t m_step;
+        bool m_reverse;
+        size_t m_limit;
+        size_t m_range = 0;
+        size_t m_off = 0;
+        size_t m_skip = 0;
+    };
+}
@@ -1,9 +1,91 @@
+#include <cstring>
 #include <fstream>
+#include <thread>
+#include "file_stream.hpp"
 #include "frame_converter.hpp"
+#include "server.hpp"
+#include "shm_ring.hpp"
+#include "uring_file.hpp"
+
+template <typename IStream, typename OStream>
+int Run(int argc, char** argv, pool::Workers* workers, pool::Buffers* buffers)
+{
+    converter::FrameConverter<IStream, OStream> cvt;
+    cvt.SetPools(workers, buffers);
+
+    return cvt.Execute(argc, argv);
+}
+
+// One conversion, argv without the program name, on the server's pools when it runs in one
+int Convert(int argc, char** argv, pool::Workers* workers = nullptr, pool::Buffers* buffers = nullptr)
+{
+#if defined(_WIN32)
+    return Run<std::ifstream, std::ofstream>(argc, argv, workers, buffers);
+#else
+    // the I/O backend is a template parameter of the converter, pick it before parsing the rest. A ring takes
+    // both streams, so --io direct or uring next to one is refused by the converter
+    for (int i = 0; i < argc; i++)
+    {
+        if (io::ShmFile::IsRing(argv[i]))
+        {
+            return Run<io::ShmFile, io::ShmFile>(argc, argv, workers, buffers);
+        }
+    }
+    for (int i = 0; i + 1 < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--io") == 0 && std::strcmp(argv[i + 1], "direct") == 0)
+        {
+            return Run<io::DirectFile, io::DirectFile>(argc, argv, workers, buffers);
+        }
+#if defined(__linux__)
+        if (std::strcmp(argv[i], "--io") == 0 && std::strcmp(argv[i + 1], "uring") == 0)
+        {
+            return Run<io::UringFile, io::UringFile>(argc, argv, workers, buffers);
+        }
+#endif
+    }
+
+    return Run<io::File, io::File>(argc, argv, workers, buffers);
+#endif
+}
 
 int main(int argc, char** argv)
 {
-    converter::FrameConverter<std::ifstream, std::ofstream> cvt;
+#if !defined(_WIN32)
+    // page cache handling is a property of the file backend, not of the conversion
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--drop-cache") == 0)
+        {
+            io::File::DropCache(true);
+        }
+    }
+
+    // serve <socket> or --serve <socket> [--jobs <N>] [--threads <N>] keeps running conversions sent to the socket
+    if (argc >= 3 && (std::strcmp(argv[1], "serve") == 0 || std::strcmp(argv[1], "--serve") == 0))
+    {
+        size_t jobs = 2;
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 3; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            {
+                jobs = strtoull(argv[++i], nullptr, 10);
+            }
+            else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            {
+                threads = strtoull(argv[++i], nullptr, 10);
+            }
+            else if (std::strcmp(argv[i], "--drop-cache") != 0)
+            {
+                return -1;
+            }
+        }
+        server::Server srv(jobs, threads, Convert);
+
+        return srv.Run(argv[2]);
+    }
+#endif
 
-    return cvt.Execute(argc - 1, &argv[1]);
+    return Convert(argc - 1, &argv[1]);
 }
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace metrics
+{
+    struct PlaneStats
+    {
+        uint64_t sse = 0;
+        uint64_t pixels = 0;
+        uint32_t maxDiff = 0;
+        double ssim = 0;
+        uint64_t ssimWindows = 0;
+
+        void Merge(const PlaneStats& other)
+        {
+            sse += other.sse;
+            pixels += other.pixels;
+            maxDiff = std::max(maxDiff, other.maxDiff);
+            ssim += other.ssim;
+            ssimWindows += other.ssimWindows;
+        }
+
+        double PSNR(uint8_t depth) const
+        {
+            if (sse == 0)
+            {
+                return std::numeric_limits<double>::infinity();
+            }
+
+            double peak = static_cast<double>((1 << depth) - 1);
+            return 10.0 * std::log10(peak * peak * pixels / sse);
+        }
+
+        double SSIM() const
+        {
+            return ssimWindows ? ssim / ssimWindows : 1.0;
+        }
+    };
+
+    // A plane of the Raw representation, only the w x h visible area is measured
+    struct Plane
+    {
+        const uint16_t* data;
+        size_t stride;
+        size_t w;
+        size_t h;
+    };
+
+    // Squared error and max abs diff of rows [rowBeg, rowEnd), the inner loop is branch free so it vectorizes
+    inline void Distortion(const Plane& a, const Plane& b, size_t rowBeg, size_t rowEnd, PlaneStats& stats)
+    {
+        for (size_t y = rowBeg; y < rowEnd; y++)
+        {
+            const uint16_t* pa = a.data + y * a.stride;
+            const uint16_t* pb = b.data + y * b.stride;
+            uint64_t sse = 0;
+            uint32_t maxDiff = 0;
+            for (size_t x = 0; x < a.w; x++)
+            {
+                int32_t d = static_cast<int32_t>(pa[x]) - static_cast<int32_t>(pb[x]);
+                uint32_t ad = static_cast<uint32_t>(d < 0 ? -d : d);
+                sse += static_cast<uint64_t>(ad) * ad;
+                maxDiff = ad > maxDiff ? ad : maxDiff;
+            }
+            stats.sse += sse;
+            stats.maxDiff = std::max(stats.maxDiff, maxDiff);
+        }
+        stats.pixels += (rowEnd - rowBeg) * a.w;
+    }
+
+    // SSIM over 8x8 windows on a 4 pixel grid (as x264 does), windows are built from 4x4 block sums so
+    // each pixel is visited once. Covers the windows whose top block row is in [blkRowBeg, blkRowEnd).
+    inline void SSIM(const Plane& a, const Plane& b, uint8_t depth, size_t blkRowBeg, size_t blkRowEnd, PlaneStats& stats)
+    {
+        struct Sums
+        {
+            uint64_t a, b, aa, bb, ab;
+        };
+
+        size_t blkW = a.w / 4;
+        size_t blkH = a.h / 4;
+        if (blkW < 2 || blkH < 2)
+        {
+            return;
+        }
+        blkRowEnd = std::min(blkRowEnd, blkH - 1);
+
+        double peak = static_cast<double>((1 << depth) - 1);
+        // sums are over N = 64 pixels, so both constants are scaled by N^2
+        double c1 = (0.01 * peak) * (0.01 * peak) * 64 * 64;
+        double c2 = (0.03 * peak) * (0.03 * peak) * 64 * 64;
+
+        std::vector<uint64_t> colA(a.w), colB(a.w), colAA(a.w), colBB(a.w), colAB(a.w);
+        auto blockRow = [&](size_t by, std::vector<Sums>& sums) {
+            std::fill(colA.begin(), colA.end(), 0);
+            std::fill(colB.begin(), colB.end(), 0);
+            std::fill(colAA.begin(), colAA.end(), 0);
+            std::fill(colBB.begin(), colBB.end(), 0);
+            std::fill(colAB.begin(), colAB.end(), 0);
+            for (size_t y = by * 4; y < by * 4 + 4; y++)
+            {
+                const uint16_t* pa = a.data + y * a.stride;
+                const uint16_t* pb = b.data + y * b.stride;
+                for (size_t x = 0; x < blkW * 4; x++)
+                {
+                    uint64_t va = pa[x];
+                    uint64_t vb = pb[x];
+                    colA[x] += va;
+                    colB[x] += vb;
+                    colAA[x] += va * va;
+                    colBB[x] += vb * vb;
+                    colAB[x] += va * vb;
+                }
+            }
+            for (size_t bx = 0; bx < blkW; bx++)
+            {
+                auto x = bx * 4;
+                sums[bx] = {colA[x] + colA[x + 1] + colA[x + 2] + colA[x + 3],
+                            colB[x] + colB[x + 1] + colB[x + 2] + colB[x + 3],
+                            colAA[x] + colAA[x + 1] + colAA[x + 2] + colAA[x + 3],
+                            colBB[x] + colBB[x + 1] + colBB[x + 2] + colBB[x + 3],
+                            colAB[x] + colAB[x + 1] + colAB[x + 2] + colAB[x + 3]};
+            }
+        };
+
+        std::vector<Sums> top(blkW), bottom(blkW);
+        if (blkRowBeg < blkRowEnd)
+        {
+            blockRow(blkRowBeg, top);
+        }
+        for (size_t by = blkRowBeg; by < blkRowEnd; by++)
+        {
+            blockRow(by + 1, bottom);
+            for (size_t bx = 0; bx + 1 < blkW; bx++)
+            {
+                double s1 = static_cast<double>(top[bx].a + top[bx + 1].a + bottom[bx].a + bottom[bx + 1].a);
+                double s2 = static_cast<double>(top[bx].b + top[bx + 1].b + bottom[bx].b + bottom[bx + 1].b);
+                double ss = static_cast<double>(top[bx].aa + top[bx + 1].aa + bottom[bx].aa + bottom[bx + 1].aa +
+                                                top[bx].bb + top[bx + 1].bb + bottom[bx].bb + bottom[bx + 1].bb);
+                double s12 = static_cast<double>(top[bx].ab + top[bx + 1].ab + bottom[bx].ab + bottom[bx + 1].ab);
+                double vars = ss * 64 - s1 * s1 - s2 * s2;
+                double covar = s12 * 64 - s1 * s2;
+                stats.ssim += (2 * s1 * s2 + c1) * (2 * covar + c2) / ((s1 * s1 + s2 * s2 + c1) * (vars + c2));
+            }
+            stats.ssimWindows += blkW - 1;
+            std::swap(top, bottom);
+        }
+    }
+}
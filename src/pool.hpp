@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "affinity.hpp"
+
+namespace pool
+{
+    // Threads kept across jobs, the tasks of every job queue for them. A thread that waits for a task through
+    // Wait runs queued tasks meanwhile, so a task that waits for tasks of its own never starves the pool. A task
+    // may pin its thread, the thread's cpus are restored after it.
+    class Workers
+    {
+    public:
+        explicit Workers(size_t threads) : m_cpus(affinity::Current())
+        {
+            for (size_t i = 0; i < std::max<size_t>(threads, 1); i++)
+            {
+                m_threads.emplace_back([this]() {
+                    while (true)
+                    {
+                        std::packaged_task<void()> task;
+                        {
+                            std::unique_lock<std::mutex> lock(m_mutex);
+                            m_cv.wait(lock, [this]() { return !m_queue.empty() || m_stop; });
+                            if (m_queue.empty())
+                            {
+                                return;
+                            }
+                            task = std::move(m_queue.front());
+                            m_queue.pop_front();
+                        }
+                        Run(task);
+                    }
+                });
+            }
+        }
+
+        Workers(const Workers&) = delete;
+        Workers& operator=(const Workers&) = delete;
+
+        // Queued tasks still run
+        ~Workers()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            for (auto& thread : m_threads)
+            {
+                thread.join();
+            }
+        }
+
+        size_t Size() const
+        {
+            return m_threads.size();
+        }
+
+        template <typename Fn>
+        std::future<void> Submit(Fn&& fn)
+        {
+            std::packaged_task<void()> task(std::forward<Fn>(fn));
+            auto future = task.get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queue.push_back(std::move(task));
+            }
+            m_cv.notify_one();
+
+            return future;
+        }
+
+        void Wait(std::future<void>& future)
+        {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                std::packaged_task<void()> task;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (!m_queue.empty())
+                    {
+                        task = std::move(m_queue.front());
+                        m_queue.pop_front();
+                    }
+                }
+                if (!task.valid())
+                {
+                    // nothing left to help with, the task is running on another thread
+                    future.wait();
+                    return;
+                }
+                Run(task);
+            }
+        }
+
+    private:
+        void Run(std::packaged_task<void()>& task)
+        {
+            task();
+            if (!m_cpus.empty())
+            {
+                affinity::Pin(m_cpus);
+            }
+        }
+
+        const std::vector<int> m_cpus;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<std::packaged_task<void()>> m_queue;
+        bool m_stop = false;
+        std::vector<std::thread> m_threads;
+    };
+
+    class Buffers;
+
+    // Gives a buffer back to its pool, or deletes it when it came from none
+    struct Release
+    {
+        Buffers* pool = nullptr;
+        size_t size = 0;
+
+        void operator()(char* p) const;
+    };
+
+    using Buffer = std::unique_ptr<char[], Release>;
+
+    // Frame buffers kept across jobs, keyed by size: a job of the same geometry as an earlier one gets its
+    // buffers back with their pages already mapped. Free buffers above limit bytes are deleted, the largest
+    // first. A buffer comes back with what its last user left in it, as from new char[].
+    class Buffers
+    {
+    public:
+        explicit Buffers(size_t limit) : m_limit(limit) {}
+
+        Buffers(const Buffers&) = delete;
+        Buffers& operator=(const Buffers&) = delete;
+
+        ~Buffers()
+        {
+            for (auto& entry : m_free)
+            {
+                delete[] entry.second;
+            }
+        }
+
+        Buffer Get(size_t size)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_free.find(size);
+                if (it != m_free.end())
+                {
+                    char* p = it->second;
+                    m_free.erase(it);
+                    m_kept -= size;
+                    return Buffer(p, Release{ this, size });
+                }
+            }
+
+            return Buffer(new char[size], Release{ this, size });
+        }
+
+        // Bytes of the free buffers
+        size_t Kept() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_kept;
+        }
+
+    private:
+        friend struct Release;
+
+        void Put(char* p, size_t size)
+        {
+            std::vector<char*> drop;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_free.emplace(size, p);
+                m_kept += size;
+                while (m_kept > m_limit)
+                {
+                    auto largest = std::prev(m_free.end());
+                    m_kept -= largest->first;
+                    drop.push_back(largest->second);
+                    m_free.erase(largest);
+                }
+            }
+            for (char* d : drop)
+            {
+                delete[] d;
+            }
+        }
+
+        const size_t m_limit;
+        mutable std::mutex m_mutex;
+        std::multimap<size_t, char*> m_free;
+        size_t m_kept = 0;
+    };
+
+    inline void Release::operator()(char* p) const
+    {
+        if (pool)
+        {
+            pool->Put(p, size);
+        }
+        else
+        {
+            delete[] p;
+        }
+    }
+
+    // A buffer of the pool, or a plain one when there is none
+    inline Buffer Take(Buffers* buffers, size_t size)
+    {
+        return buffers ? buffers->Get(size) : Buffer(new char[size], Release{ nullptr, size });
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+namespace progress
+{
+    // Bumped by the workers and the I/O, the reporter only samples them
+    struct Counters
+    {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> bytesIn{0};
+        std::atomic<uint64_t> bytesOut{0};
+    };
+
+    // Nothing is ordered on the counters, a relaxed add is a plain locked add with no fences around it
+    inline void Add(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Samples the counters on a thread of its own and prints one JSON object per line, the last one when it is
+    // destroyed with "done" set and "ok" telling whether the job succeeded (Succeeded). Rates are over the last interval, the ETA follows the average frame rate of the
+    // run. total is 0 when the length of the job is not known, a pipe, and "total" and "eta" are then null.
+    class Reporter
+    {
+    public:
+        Reporter(const Counters& counters, uint64_t total, std::ostream& os,
+                 std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+            : m_counters(counters), m_total(total), m_os(os), m_interval(interval)
+        {
+            m_start = m_last = Clock::now();
+            m_startFrames = m_lastFrames = m_counters.frames.load(std::memory_order_relaxed);
+            m_lastIn = m_counters.bytesIn.load(std::memory_order_relaxed);
+            m_lastOut = m_counters.bytesOut.load(std::memory_order_relaxed);
+            m_thread = std::thread([this]() {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (!m_cv.wait_for(lock, m_interval, [this]() { return m_stop; }))
+                {
+                    Print(false);
+                }
+            });
+        }
+
+        Reporter(const Reporter&) = delete;
+        Reporter& operator=(const Reporter&) = delete;
+
+        // Called by the owner before destroying the reporter when the job ran to its end
+        void Succeeded()
+        {
+            m_ok = true;
+        }
+
+        ~Reporter()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_one();
+            m_thread.join();
+            Print(true);
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void Print(bool done)
+        {
+            const auto now = Clock::now();
+            const uint64_t frames = m_counters.frames.load(std::memory_order_relaxed);
+            const uint64_t in = m_counters.bytesIn.load(std::memory_order_relaxed);
+            const uint64_t out = m_counters.bytesOut.load(std::memory_order_relaxed);
+            const double elapsed = std::chrono::duration<double>(now - m_start).count();
+            const double span = std::chrono::duration<double>(now - m_last).count();
+            auto rate = [](double amount, double seconds) { return seconds > 0 ? amount / seconds : 0.0; };
+            const double avgFps = rate(static_cast<double>(frames - m_startFrames), elapsed);
+
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(2) << "{\"frames\":" << frames << ",\"total\":";
+            if (m_total != 0)
+            {
+                line << m_total;
+            }
+            else
+            {
+                line << "null";
+            }
+            line << ",\"fps\":" << rate(static_cast<double>(frames - m_lastFrames), span) << ",\"avg_fps\":" << avgFps
+                 << ",\"read_mbps\":" << rate((in - m_lastIn) / 1e6, span)
+                 << ",\"write_mbps\":" << rate((out - m_lastOut) / 1e6, span)
+                 << ",\"elapsed\":" << elapsed << ",\"eta\":";
+            if (m_total != 0 && (done || avgFps > 0))
+            {
+                line << (done || frames >= m_total ? 0.0 : (m_total - frames) / avgFps);
+            }
+            else
+            {
+                line << "null";
+            }
+            line << ",\"done\":" << (done ? "true" : "false");
+            if (done)
+            {
+                line << ",\"ok\":" << (m_ok ? "true" : "false");
+            }
+            line << "}\n";
+            // one write per line, so lines of other writers to the stream are not split
+            m_os << line.str() << std::flush;
+
+            m_last = now;
+            m_lastFrames = frames;
+            m_lastIn = in;
+            m_lastOut = out;
+        }
+
+        const Counters& m_counters;
+        const uint64_t m_total;
+        std::ostream& m_os;
+        const std::chrono::milliseconds m_interval;
+        Clock::time_point m_start;
+        Clock::time_point m_last;
+        uint64_t m_startFrames = 0;
+        uint64_t m_lastFrames = 0;
+        uint64_t m_lastIn = 0;
+        uint64_t m_lastOut = 0;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop = false;
+        bool m_ok = false;
+        std::thread m_thread;
+    };
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace scaler
+{
+    enum class FILTER
+    {
+        BILINEAR = 0,  // triangle, 2 taps when upscaling
+        AREA     = 1,  // box weighted by the covered area
+        BICUBIC  = 2   // Catmull-Rom (a = -0.5), 4 taps when upscaling
+    };
+
+    // Weights of one dimension, every output sample reads n consecutive source samples from start
+    struct Taps
+    {
+        size_t n = 0;
+        std::vector<size_t> start;
+        std::vector<float> weights;
+    };
+
+    inline double Kernel(FILTER filter, double d)
+    {
+        d = std::fabs(d);
+        switch (filter)
+        {
+        case FILTER::BICUBIC:
+        {
+            constexpr double a = -0.5;
+            if (d < 1.0)
+            {
+                return ((a + 2) * d - (a + 3)) * d * d + 1;
+            }
+            return d < 2.0 ? ((a * d - 5 * a) * d + 8 * a) * d - 4 * a : 0.0;
+        }
+        case FILTER::BILINEAR:
+        default:
+            return d < 1.0 ? 1.0 - d : 0.0;
+        }
+    }
+
+    inline Taps MakeTaps(size_t srcLen, size_t dstLen, FILTER filter)
+    {
+        const double scale = static_cast<double>(srcLen) / dstLen;
+        // the kernel is stretched when downscaling so every source sample contributes
+        const double stretch = std::max(scale, 1.0);
+        const double support = (filter == FILTER::BICUBIC ? 2.0 : filter == FILTER::BILINEAR ? 1.0 : 0.5) * stretch;
+
+        Taps taps;
+        taps.n = std::min(srcLen, static_cast<size_t>(std::ceil(support * 2)) + 2);
+        taps.start.resize(dstLen);
+        taps.weights.resize(dstLen * taps.n);
+
+        for (size_t i = 0; i < dstLen; i++)
+        {
+            const double center = (i + 0.5) * scale;
+            auto first = static_cast<long long>(std::floor(center - support - 0.5));
+            first = std::max(0LL, std::min(first, static_cast<long long>(srcLen - taps.n)));
+            taps.start[i] = static_cast<size_t>(first);
+
+            auto w = &taps.weights[i * taps.n];
+            double sum = 0;
+            for (size_t k = 0; k < taps.n; k++)
+            {
+                double x = static_cast<double>(first + k);
+                double weight = 0;
+                if (filter == FILTER::AREA)
+                {
+                    weight = std::max(0.0, std::min(x + 1, center + stretch / 2) - std::max(x, center - stretch / 2));
+                }
+                else
+                {
+                    weight = Kernel(filter, (x + 0.5 - center) / stretch);
+                }
+                w[k] = static_cast<float>(weight);
+                sum += weight;
+            }
+            for (size_t k = 0; k < taps.n; k++)
+            {
+                w[k] = static_cast<float>(w[k] / sum);
+            }
+        }
+
+        return taps;
+    }
+
+    // The taps of both passes over one plane geometry. They only depend on the sizes and the filter, so they
+    // are built once and reused for every frame scaled alike.
+    struct PlaneTaps
+    {
+        size_t srcW = 0;
+        size_t srcH = 0;
+        size_t dstW = 0;
+        size_t dstH = 0;
+        FILTER filter = FILTER::BICUBIC;
+        Taps h;
+        Taps v;
+
+        void Prepare(size_t fromW, size_t fromH, size_t toW, size_t toH, FILTER with)
+        {
+            if (fromW == srcW && fromH == srcH && toW == dstW && toH == dstH && with == filter)
+            {
+                return;
+            }
+
+            srcW = fromW;
+            srcH = fromH;
+            dstW = toW;
+            dstH = toH;
+            filter = with;
+            const bool empty = srcW == 0 || srcH == 0 || dstW == 0 || dstH == 0;
+            h = empty ? Taps() : MakeTaps(srcW, dstW, filter);
+            v = empty ? Taps() : MakeTaps(srcH, dstH, filter);
+        }
+    };
+
+    // Separable resampling of the visible area of a plane: a horizontal pass into a float scratch plane,
+    // then a vertical pass that accumulates whole rows so its inner loop is contiguous and vectorizes.
+    inline void ScalePlane(const uint16_t* src, size_t srcStride, uint16_t* dst, size_t dstStride, const PlaneTaps& taps,
+                           uint16_t maxValue)
+    {
+        const size_t srcH = taps.srcH;
+        const size_t dstW = taps.dstW;
+        const size_t dstH = taps.dstH;
+        if (taps.srcW == 0 || srcH == 0 || dstW == 0 || dstH == 0)
+        {
+            return;
+        }
+
+        const Taps& hTaps = taps.h;
+        const Taps& vTaps = taps.v;
+
+        thread_local std::vector<float> tmp;
+        thread_local std::vector<float> acc;
+        tmp.resize(srcH * dstW);
+        acc.resize(dstW);
+
+        for (size_t y = 0; y < srcH; y++)
+        {
+            const uint16_t* row = src + y * srcStride;
+            float* out = tmp.data() + y * dstW;
+            for (size_t x = 0; x < dstW; x++)
+            {
+                const uint16_t* s = row + hTaps.start[x];
+                const float* w = &hTaps.weights[x * hTaps.n];
+                float sum = 0;
+                for (size_t k = 0; k < hTaps.n; k++)
+                {
+                    sum += w[k] * s[k];
+                }
+                out[x] = sum;
+            }
+        }
+
+        const float maxV = static_cast<float>(maxValue);
+        for (size_t y = 0; y < dstH; y++)
+        {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            for (size_t k = 0; k < vTaps.n; k++)
+            {
+                const float w = vTaps.weights[y * vTaps.n + k];
+                const float* row = tmp.data() + (vTaps.start[y] + k) * dstW;
+                for (size_t x = 0; x < dstW; x++)
+                {
+                    acc[x] += w * row[x];
+                }
+            }
+
+            uint16_t* out = dst + y * dstStride;
+            for (size_t x = 0; x < dstW; x++)
+            {
+                out[x] = static_cast<uint16_t>(std::min(std::max(acc[x] + 0.5f, 0.0f), maxV));
+            }
+        }
+    }
+}
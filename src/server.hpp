@@ -0,0 +1,377 @@
+#pragma once
+
+#if !defined(_WIN32)
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "pool.hpp"
+
+namespace server
+{
+    // A resident process that runs conversions sent over a Unix domain socket, so many short clips do not each
+    // pay for a process start and for faulting in fresh frame buffers.
+    //
+    // A request is the command line of one conversion, every argument ending with '\0' and an empty argument
+    // ending the request. Files may be passed as descriptors with SCM_RIGHTS alongside the request, an argument
+    // "&<n>" then names the n-th of them; other paths are taken from the daemon's working directory. The reply
+    // is "<n> <exit code>\n" for the n-th request of the connection, requests of one connection may run side by
+    // side and complete in any order. A connection may send any number of requests.
+    //
+    // Up to jobs conversions run at once, each on threads / jobs cores unless it asks for --threads. Queued
+    // requests are taken round robin across connections, so a client with a long queue does not hold back the
+    // others. The worker threads and the frame buffers are the server's: every conversion runs its tasks on the
+    // same threads and gets buffers of a size an earlier one used back from the pool.
+    using Convert = std::function<int(int argc, char** argv, pool::Workers* workers, pool::Buffers* buffers)>;
+
+    class Server
+    {
+    public:
+        Server(size_t jobs, size_t threads, Convert convert)
+            : m_jobs(std::max<size_t>(jobs, 1)), m_convert(std::move(convert)), m_workers(threads), m_buffers(KEPT_BYTES)
+        {
+            m_threads = std::to_string(std::max<size_t>(threads / m_jobs, 1));
+        }
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        // Serves until SIGINT or SIGTERM, then lets the queued requests finish
+        int Run(const std::string& path)
+        {
+            sockaddr_un addr{};
+            if (path.size() >= sizeof(addr.sun_path) || ::pipe(_wake) != 0)
+            {
+                return -1;
+            }
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            ::unlink(path.c_str());
+            if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0)
+            {
+                if (fd >= 0)
+                {
+                    ::close(fd);
+                }
+                return -1;
+            }
+            std::signal(SIGINT, Stop);
+            std::signal(SIGTERM, Stop);
+            // a client that goes away must not take the daemon with it
+            std::signal(SIGPIPE, SIG_IGN);
+
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            std::vector<std::thread> runners;
+            for (size_t i = 0; i < m_jobs; i++)
+            {
+                runners.emplace_back([this]() { RunJobs(); });
+            }
+            while (true)
+            {
+                pollfd fds[] = { { fd, POLLIN, 0 }, { _wake[0], POLLIN, 0 } };
+                if (::poll(fds, 2, -1) < 0 && errno != EINTR)
+                {
+                    break;
+                }
+                if (fds[1].revents != 0)
+                {
+                    break;
+                }
+                if ((fds[0].revents & POLLIN) == 0)
+                {
+                    continue;
+                }
+                int conn = ::accept(fd, nullptr, nullptr);
+                if (conn < 0)
+                {
+                    continue;
+                }
+                ::fcntl(conn, F_SETFD, FD_CLOEXEC);
+                auto session = std::make_shared<Session>();
+                session->fd = conn;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_sessions.remove_if([](const std::weak_ptr<Session>& weak) { return weak.expired(); });
+                    m_sessions.push_back(session);
+                    m_readers++;
+                }
+                // a reader lives as long as its connection, the last one out is waited for below
+                std::thread([this, session]() {
+                    Read(session);
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_readers--;
+                    m_cv.notify_all();
+                }).detach();
+            }
+
+            ::close(fd);
+            ::unlink(path.c_str());
+            {
+                // readers stop at the next request, what is queued still runs
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_stopping = true;
+                for (auto& weak : m_sessions)
+                {
+                    if (auto session = weak.lock())
+                    {
+                        ::shutdown(session->fd, SHUT_RD);
+                    }
+                }
+                m_cv.notify_all();
+                m_cv.wait(lock, [this]() { return m_readers == 0; });
+            }
+            for (auto& runner : runners)
+            {
+                runner.join();
+            }
+
+            return 0;
+        }
+
+    private:
+#if defined(MSG_CMSG_CLOEXEC)
+        static constexpr int RECV_FLAGS = MSG_CMSG_CLOEXEC;
+#else
+        static constexpr int RECV_FLAGS = 0;
+#endif
+        // free frame buffers kept between jobs
+        static constexpr size_t KEPT_BYTES = size_t(1) << 30;
+
+        struct Job
+        {
+            size_t seq = 0;
+            std::vector<std::string> args;
+            std::vector<int> fds;
+        };
+
+        struct Session
+        {
+            int fd = -1;
+            std::mutex send;
+            // guarded by the server's mutex
+            std::deque<Job> pending;
+            bool queued = false;
+
+            ~Session()
+            {
+                ::close(fd);
+                for (auto& job : pending)
+                {
+                    Close(job.fds);
+                }
+            }
+        };
+
+        static void Close(const std::vector<int>& fds)
+        {
+            for (int fd : fds)
+            {
+                ::close(fd);
+            }
+        }
+
+        static void Stop(int)
+        {
+            char c = 0;
+            (void)!::write(_wake[1], &c, 1);
+        }
+
+        // Splits the stream into requests, descriptors arriving with a request's bytes belong to it
+        void Read(std::shared_ptr<Session> session)
+        {
+            std::vector<int> fds;
+            std::vector<std::string> args(1);
+            size_t seq = 0;
+            char buf[4096];
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * 64)];
+            while (true)
+            {
+                iovec iov = { buf, sizeof(buf) };
+                msghdr msg{};
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                auto got = ::recvmsg(session->fd, &msg, RECV_FLAGS);
+                if (got < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                for (auto cm = CMSG_FIRSTHDR(&msg); got >= 0 && cm; cm = CMSG_NXTHDR(&msg, cm))
+                {
+                    if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+                    {
+                        const size_t n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                        const int* data = reinterpret_cast<const int*>(CMSG_DATA(cm));
+                        fds.insert(fds.end(), data, data + n);
+                    }
+                }
+                if (got <= 0)
+                {
+                    break;
+                }
+
+                for (ssize_t i = 0; i < got; i++)
+                {
+                    if (buf[i] != '\0')
+                    {
+                        args.back() += buf[i];
+                        continue;
+                    }
+                    if (!args.back().empty())
+                    {
+                        args.emplace_back();
+                        continue;
+                    }
+
+                    args.pop_back();
+                    Job job;
+                    job.seq = seq++;
+                    job.args.swap(args);
+                    job.fds.swap(fds);
+                    args.resize(1);
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_stopping)
+                    {
+                        Close(job.fds);
+                        continue;
+                    }
+                    session->pending.push_back(std::move(job));
+                    if (!session->queued)
+                    {
+                        session->queued = true;
+                        m_ready.push_back(session);
+                    }
+                    m_cv.notify_one();
+                }
+            }
+            Close(fds);
+        }
+
+        void RunJobs()
+        {
+            while (true)
+            {
+                std::shared_ptr<Session> session;
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_cv.wait(lock, [this]() { return !m_ready.empty() || m_stopping; });
+                    if (m_ready.empty())
+                    {
+                        return;
+                    }
+                    // one request of the connection at the front, then it goes to the back of the line
+                    session = m_ready.front();
+                    m_ready.pop_front();
+                    job = std::move(session->pending.front());
+                    session->pending.pop_front();
+                    session->queued = !session->pending.empty();
+                    if (session->queued)
+                    {
+                        m_ready.push_back(session);
+                    }
+                }
+
+                const std::string reply = std::to_string(job.seq) + " " + std::to_string(Execute(job)) + "\n";
+                Close(job.fds);
+                std::lock_guard<std::mutex> lock(session->send);
+                for (size_t done = 0; done < reply.size();)
+                {
+                    auto ret = ::send(session->fd, reply.data() + done, reply.size() - done, MSG_NOSIGNAL);
+                    if (ret < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (ret <= 0)
+                    {
+                        break;
+                    }
+                    done += ret;
+                }
+            }
+        }
+
+        int Execute(const Job& job)
+        {
+            std::vector<std::string> args;
+            bool threads = false;
+            for (const auto& arg : job.args)
+            {
+                if (arg == "-")
+                {
+                    // stdin and stdout are the daemon's, a pipe is passed as a descriptor
+                    return -1;
+                }
+                if (arg.size() > 1 && arg[0] == '&')
+                {
+                    char* end = nullptr;
+                    size_t n = std::strtoull(arg.c_str() + 1, &end, 10);
+                    if (*end != '\0' || n >= job.fds.size())
+                    {
+                        return -1;
+                    }
+                    args.push_back("/dev/fd/" + std::to_string(job.fds[n]));
+                    continue;
+                }
+                threads = threads || arg == "--threads";
+                args.push_back(arg);
+            }
+            if (args.empty())
+            {
+                return -1;
+            }
+            if (!threads)
+            {
+                args.push_back("--threads");
+                args.push_back(m_threads);
+            }
+            args.push_back("--quiet");
+
+            std::vector<char*> argv;
+            for (auto& arg : args)
+            {
+                argv.push_back(&arg[0]);
+            }
+            try
+            {
+                return m_convert(static_cast<int>(argv.size()), argv.data(), &m_workers, &m_buffers);
+            }
+            catch (const std::exception&)
+            {
+                return -1;
+            }
+        }
+
+        const size_t m_jobs;
+        std::string m_threads;
+        Convert m_convert;
+        pool::Workers m_workers;
+        pool::Buffers m_buffers;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::list<std::shared_ptr<Session>> m_ready;
+        std::list<std::weak_ptr<Session>> m_sessions;
+        size_t m_readers = 0;
+        bool m_stopping = false;
+        static inline int _wake[2] = { -1, -1 };
+    };
+}
+#endif
@@ -0,0 +1,331 @@
+#pragma once
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include "file_stream.hpp"
+
+namespace io
+{
+    // A ring of fixed size slots in POSIX shared memory, written by one process and read by another. The
+    // writer fills the slot at head and publishes it by moving head on, the reader drains the slot at tail and
+    // hands it back by moving tail on; each index has a single writer, so the release store of one and the
+    // acquire load on the other side are the whole protocol. Whoever owns the frames creates the ring (the
+    // capture process for an input, the consumer for an output), this side only attaches to it.
+    //
+    // Layout, for the process on the other side:
+    //   0    RingHeader
+    //   256  uint64_t used[slots], the bytes of the stream in each published slot
+    //   dataOffset  slots * slotSize bytes of slots
+    struct RingHeader
+    {
+        char magic[8];
+        uint64_t slotSize;
+        uint64_t slots;
+        uint64_t dataOffset;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) std::atomic<uint32_t> writerDone;
+        std::atomic<uint32_t> readerGone;
+    };
+
+    class ShmRing
+    {
+    public:
+        static constexpr char MAGIC[8] = { 'Y', 'U', 'V', 'R', 'I', 'N', 'G', '1' };
+        static constexpr size_t USED_OFFSET = 256;
+
+        ShmRing() = default;
+        ShmRing(const ShmRing&) = delete;
+        ShmRing& operator=(const ShmRing&) = delete;
+
+        ~ShmRing()
+        {
+            Detach();
+        }
+
+        // Lays out a new ring of slots of slotSize bytes, for producers and consumers written against this header
+        static bool Create(const std::string& name, uint64_t slotSize, uint64_t slots)
+        {
+            const uint64_t dataOffset = (USED_OFFSET + slots * sizeof(uint64_t) + 4095) & ~uint64_t(4095);
+            const uint64_t size = dataOffset + slots * slotSize;
+            int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0 || slotSize == 0 || slots == 0 || ::ftruncate(fd, static_cast<off_t>(size)) != 0)
+            {
+                if (fd >= 0)
+                {
+                    ::close(fd);
+                    ::shm_unlink(name.c_str());
+                }
+                return false;
+            }
+            void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+            {
+                ::shm_unlink(name.c_str());
+                return false;
+            }
+
+            auto hdr = new (p) RingHeader();
+            hdr->slotSize = slotSize;
+            hdr->slots = slots;
+            hdr->dataOffset = dataOffset;
+            std::atomic_thread_fence(std::memory_order_release);
+            // the magic goes last, a ring is not attached before it is laid out
+            std::memcpy(hdr->magic, MAGIC, sizeof(MAGIC));
+            ::munmap(p, size);
+
+            return true;
+        }
+
+        // fd is the shm_open descriptor, kept by the caller
+        bool Attach(int fd, bool writer)
+        {
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < USED_OFFSET)
+            {
+                return false;
+            }
+            m_size = static_cast<size_t>(st.st_size);
+            void* p = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                return false;
+            }
+            m_hdr = static_cast<RingHeader*>(p);
+            if (std::memcmp(m_hdr->magic, MAGIC, sizeof(MAGIC)) != 0 || m_hdr->slots == 0 || m_hdr->slotSize == 0 ||
+                m_hdr->dataOffset < USED_OFFSET + m_hdr->slots * sizeof(uint64_t) ||
+                m_hdr->dataOffset + m_hdr->slots * m_hdr->slotSize > m_size)
+            {
+                Detach();
+                return false;
+            }
+            m_used = reinterpret_cast<uint64_t*>(static_cast<char*>(p) + USED_OFFSET);
+            m_data = static_cast<char*>(p) + m_hdr->dataOffset;
+            m_writer = writer;
+            m_head = m_hdr->head.load(std::memory_order_acquire);
+            m_tail = m_hdr->tail.load(std::memory_order_acquire);
+            m_slotOff = 0;
+
+            return true;
+        }
+
+        // A writer publishes what it holds and marks the end of the stream, a reader tells the writer it left
+        void Detach()
+        {
+            if (!m_hdr)
+            {
+                return;
+            }
+            if (m_writer)
+            {
+                Publish();
+                m_hdr->writerDone.store(1, std::memory_order_release);
+            }
+            else
+            {
+                m_hdr->readerGone.store(1, std::memory_order_release);
+            }
+            ::munmap(m_hdr, m_size);
+            m_hdr = nullptr;
+        }
+
+        // Bytes read, short only at the end of the stream
+        size_t Read(char* s, size_t n)
+        {
+            size_t got = 0;
+            while (got < n)
+            {
+                if (m_slotOff == 0 && !Wait([this]() { return m_hdr->head.load(std::memory_order_acquire) != m_tail; },
+                                            [this]() { return m_hdr->writerDone.load(std::memory_order_acquire) != 0; }))
+                {
+                    break;
+                }
+                const uint64_t slot = m_tail % m_hdr->slots;
+                const size_t used = static_cast<size_t>(std::min(m_used[slot], m_hdr->slotSize));
+                const size_t size = std::min(used - m_slotOff, n - got);
+                std::memcpy(s + got, m_data + slot * m_hdr->slotSize + m_slotOff, size);
+                got += size;
+                m_slotOff += size;
+                if (m_slotOff == used)
+                {
+                    m_hdr->tail.store(++m_tail, std::memory_order_release);
+                    m_slotOff = 0;
+                }
+            }
+
+            return got;
+        }
+
+        // false when the reader left
+        bool Write(const char* s, size_t n)
+        {
+            for (size_t done = 0; done < n;)
+            {
+                if (m_slotOff == 0 &&
+                    !Wait([this]() { return m_head - m_hdr->tail.load(std::memory_order_acquire) < m_hdr->slots; },
+                          [this]() { return m_hdr->readerGone.load(std::memory_order_acquire) != 0; }))
+                {
+                    return false;
+                }
+                const uint64_t slot = m_head % m_hdr->slots;
+                const size_t size = std::min(static_cast<size_t>(m_hdr->slotSize) - m_slotOff, n - done);
+                std::memcpy(m_data + slot * m_hdr->slotSize + m_slotOff, s + done, size);
+                done += size;
+                m_slotOff += size;
+                if (m_slotOff == m_hdr->slotSize)
+                {
+                    Publish();
+                }
+            }
+            // the reader gets every write as soon as it is made, a write of whole slots leaves none partly filled
+            Publish();
+
+            return true;
+        }
+
+    private:
+        void Publish()
+        {
+            if (m_slotOff == 0)
+            {
+                return;
+            }
+            m_used[m_head % m_hdr->slots] = m_slotOff;
+            m_hdr->head.store(++m_head, std::memory_order_release);
+            m_slotOff = 0;
+        }
+
+        // Spins briefly, then yields, then sleeps; false when the other side is done before ready turns true
+        template <typename Ready, typename Done>
+        static bool Wait(Ready ready, Done done)
+        {
+            for (unsigned spins = 0; !ready(); spins++)
+            {
+                if (done())
+                {
+                    // the last slots may have been published just before
+                    return ready();
+                }
+                if (spins >= 256)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+                else if (spins >= 64)
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            return true;
+        }
+
+        RingHeader* m_hdr = nullptr;
+        uint64_t* m_used = nullptr;
+        char* m_data = nullptr;
+        size_t m_size = 0;
+        bool m_writer = false;
+        uint64_t m_head = 0;
+        uint64_t m_tail = 0;
+        size_t m_slotOff = 0;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring indices are shared between processes");
+    static_assert(sizeof(RingHeader) <= ShmRing::USED_OFFSET, "the used sizes follow the header");
+
+    // "shm:<name>" opens the shared memory ring <name> (shm_open naming, "shm:/capture"), other paths a file.
+    // A ring streams like a pipe: it cannot seek, so the converter reads it in order.
+    class ShmFile final : public File
+    {
+    public:
+        static constexpr const char* PREFIX = "shm:";
+
+        ShmFile() = default;
+
+        ~ShmFile()
+        {
+            close();
+        }
+
+        static bool IsRing(const char* path)
+        {
+            return std::strncmp(path, PREFIX, std::strlen(PREFIX)) == 0;
+        }
+
+        void open(const std::string& filename, std::ios_base::openmode mode)
+        {
+            close();
+            if (!IsRing(filename.c_str()))
+            {
+                File::open(filename, mode);
+                return;
+            }
+
+            const std::string name = filename.substr(std::strlen(PREFIX));
+            m_out = !!(mode & std::ios_base::out);
+            m_fd = ::shm_open(name.c_str(), O_RDWR, 0);
+            m_ring = m_fd >= 0 && m_shm.Attach(m_fd, m_out);
+            m_good = m_ring;
+            m_directOn = false;
+            m_seekable = false;
+            m_pos = 0;
+        }
+
+        void close()
+        {
+            if (m_ring)
+            {
+                m_shm.Detach();
+                m_ring = false;
+            }
+            File::close();
+        }
+
+        ShmFile& read(char* s, std::streamsize n)
+        {
+            if (!m_ring)
+            {
+                File::read(s, n);
+                return *this;
+            }
+
+            m_gcount = m_good ? static_cast<std::streamsize>(m_shm.Read(s, static_cast<size_t>(n))) : 0;
+            m_good = m_gcount == n;
+            m_pos += m_gcount;
+
+            return *this;
+        }
+
+        ShmFile& write(const char* s, std::streamsize n)
+        {
+            if (!m_ring)
+            {
+                File::write(s, n);
+                return *this;
+            }
+
+            m_good = m_good && m_shm.Write(s, static_cast<size_t>(n));
+            m_pos += n;
+
+            return *this;
+        }
+
+    private:
+        ShmRing m_shm;
+        bool m_ring = false;
+    };
+}
+
+#endif
@@ -0,0 +1,481 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "file_stream.hpp"
+
+namespace io
+{
+    // Minimal io_uring submission/completion rings over the raw syscalls
+    class Ring
+    {
+    public:
+        Ring() = default;
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        ~Ring()
+        {
+            Close();
+        }
+
+        // Unmaps the rings and closes the ring fd, the kernel cancels what is still in flight
+        void Close()
+        {
+            if (m_sqes)
+            {
+                munmap(m_sqes, m_sqesSz);
+            }
+            if (m_cqPtr && m_cqPtr != m_sqPtr)
+            {
+                munmap(m_cqPtr, m_cqSz);
+            }
+            if (m_sqPtr)
+            {
+                munmap(m_sqPtr, m_sqSz);
+            }
+            if (m_fd >= 0)
+            {
+                ::close(m_fd);
+            }
+            m_sqes = nullptr;
+            m_sqPtr = m_cqPtr = nullptr;
+            m_fd = -1;
+            m_pending = 0;
+        }
+
+        bool Setup(unsigned entries)
+        {
+            io_uring_params p;
+            std::memset(&p, 0, sizeof(p));
+            m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+            if (m_fd < 0)
+            {
+                return false;
+            }
+
+            m_sqSz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            m_cqSz = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+            bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+            if (single)
+            {
+                m_sqSz = m_cqSz = std::max(m_sqSz, m_cqSz);
+            }
+            m_sqPtr = Map(m_sqSz, IORING_OFF_SQ_RING);
+            m_cqPtr = single ? m_sqPtr : Map(m_cqSz, IORING_OFF_CQ_RING);
+            m_sqesSz = p.sq_entries * sizeof(io_uring_sqe);
+            m_sqes = static_cast<io_uring_sqe*>(Map(m_sqesSz, IORING_OFF_SQES));
+            if (!m_sqPtr || !m_cqPtr || !m_sqes)
+            {
+                return false;
+            }
+
+            auto sq = static_cast<char*>(m_sqPtr);
+            auto cq = static_cast<char*>(m_cqPtr);
+            m_sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+            m_sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+            m_sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+            m_cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+            m_cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+            m_cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+            m_cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+            return true;
+        }
+
+        bool RegisterBuffers(const iovec* iov, unsigned num)
+        {
+            return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, iov, num) == 0;
+        }
+
+        // The caller never queues more entries than the ring holds
+        io_uring_sqe* Prepare()
+        {
+            unsigned tail = *m_sqTail;
+            unsigned idx = (tail + m_pending) & m_sqMask;
+            m_sqArray[idx] = idx;
+            m_pending++;
+            std::memset(&m_sqes[idx], 0, sizeof(io_uring_sqe));
+
+            return &m_sqes[idx];
+        }
+
+        // Publishes the prepared entries and optionally waits for minComplete completions
+        bool Enter(unsigned minComplete)
+        {
+            __atomic_store_n(m_sqTail, *m_sqTail + m_pending, __ATOMIC_RELEASE);
+            unsigned toSubmit = m_pending;
+            m_pending = 0;
+            while (toSubmit > 0 || minComplete > 0)
+            {
+                long ret = syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if (ret < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return false;
+                }
+                toSubmit -= static_cast<unsigned>(ret);
+                minComplete = 0;
+            }
+
+            return true;
+        }
+
+        template <typename Handler>
+        void Reap(Handler&& handler)
+        {
+            unsigned head = *m_cqHead;
+            unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++)
+            {
+                const auto& cqe = m_cqes[head & m_cqMask];
+                handler(cqe.user_data, cqe.res);
+            }
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        }
+
+    private:
+        void* Map(size_t size, off_t offset) const
+        {
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+            return p == MAP_FAILED ? nullptr : p;
+        }
+
+    private:
+        int m_fd = -1;
+        void* m_sqPtr = nullptr;
+        void* m_cqPtr = nullptr;
+        size_t m_sqSz = 0;
+        size_t m_cqSz = 0;
+        io_uring_sqe* m_sqes = nullptr;
+        size_t m_sqesSz = 0;
+        unsigned* m_sqTail = nullptr;
+        unsigned m_sqMask = 0;
+        unsigned* m_sqArray = nullptr;
+        unsigned* m_cqHead = nullptr;
+        unsigned* m_cqTail = nullptr;
+        unsigned m_cqMask = 0;
+        io_uring_cqe* m_cqes = nullptr;
+        unsigned m_pending = 0;
+    };
+
+    // io::File whose transfers on a regular file are split into chunks kept in flight through io_uring with
+    // registered buffers. A read waits only for its own chunks and, when it continues the previous one, queues
+    // the same amount again as readahead, so the next batch loads while the current one is converted. A write
+    // copies into free chunks and returns, the device drains them in the background. Pipes, kernels without
+    // io_uring and sandboxes that forbid it use the pread/pwrite path of io::File.
+    class UringFile final : public File
+    {
+    public:
+        UringFile() = default;
+
+        ~UringFile()
+        {
+            close();
+        }
+
+        void open(const std::string& filename, std::ios_base::openmode mode)
+        {
+            close();
+            File::open(filename, mode);
+            m_async = m_good && m_seekable && Init();
+            m_winPos = m_winEnd = 0;
+            m_eofOff = m_lastEnd = -1;
+        }
+
+        void close()
+        {
+            if (m_async)
+            {
+                // after EOF or a failed request the chunks still in flight target the fd and the buffers, every
+                // one is waited for before either goes away
+                DropWindow();
+                while (InFlight() && WaitOne())
+                {
+                }
+                if (InFlight())
+                {
+                    // the ring is unusable: closing it cancels the requests, the buffers they may still land in
+                    // are left allocated and a new ring is set up on the next open
+                    m_ring.Close();
+                    m_buf.release();
+                    m_free.clear();
+                    for (auto& slot : m_slots)
+                    {
+                        slot = Slot();
+                    }
+                    m_async = false;
+                }
+            }
+            File::close();
+        }
+
+        UringFile& read(char* s, std::streamsize n)
+        {
+            if (!m_async)
+            {
+                File::read(s, n);
+                return *this;
+            }
+
+            m_gcount = 0;
+            if (!m_good)
+            {
+                return *this;
+            }
+            if (m_pos != m_winPos)
+            {
+                DropWindow();
+                m_winPos = m_winEnd = m_pos;
+                m_eofOff = -1;
+            }
+            // a read continuing the previous one is a stream, fetch as much again ahead of it
+            const off_t limit = m_pos + n * (m_pos == m_lastEnd ? 2 : 1);
+
+            Fill(limit);
+            while (m_gcount < n)
+            {
+                if (m_window.empty())
+                {
+                    m_good = false;
+                    break;
+                }
+                auto& slot = m_slots[m_window.front()];
+                while (slot.busy && m_good)
+                {
+                    WaitOne();
+                }
+                if (slot.res < 0)
+                {
+                    m_good = false;
+                    break;
+                }
+                off_t avail = slot.off + slot.res;
+                size_t size = static_cast<size_t>(std::min<off_t>(avail - m_pos, n - m_gcount));
+                std::memcpy(s + m_gcount, m_buf.get() + m_window.front() * CHUNK + (m_pos - slot.off), size);
+                m_gcount += size;
+                m_pos += size;
+                if (m_pos < avail)
+                {
+                    continue;
+                }
+                bool eof = static_cast<size_t>(slot.res) < slot.len;
+                m_free.push_back(m_window.front());
+                m_window.pop_front();
+                if (eof)
+                {
+                    // nothing past the end of the file is worth reading
+                    m_eofOff = avail;
+                    DropWindow();
+                    m_winEnd = avail;
+                    m_good = m_gcount == n;
+                    break;
+                }
+                Fill(limit);
+            }
+            m_winPos = m_pos;
+            m_lastEnd = m_pos;
+
+            return *this;
+        }
+
+        UringFile& write(const char* s, std::streamsize n)
+        {
+            if (!m_async)
+            {
+                File::write(s, n);
+                return *this;
+            }
+
+            for (std::streamsize done = 0; m_good && done < n;)
+            {
+                while (m_free.empty() && m_good)
+                {
+                    WaitOne();
+                }
+                if (!m_good)
+                {
+                    break;
+                }
+                int id = m_free.back();
+                m_free.pop_back();
+                auto& slot = m_slots[id];
+                slot.off = m_pos;
+                slot.len = std::min(CHUNK, static_cast<size_t>(n - done));
+                slot.write = true;
+                std::memcpy(m_buf.get() + id * CHUNK, s + done, slot.len);
+                Queue(id, m_fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE);
+                done += slot.len;
+                m_pos += slot.len;
+            }
+            m_good = m_good && m_ring.Enter(0);
+
+            return *this;
+        }
+
+    private:
+        static constexpr unsigned SLOTS = 32;
+        static constexpr size_t CHUNK = 1 << 20;
+
+        struct Slot
+        {
+            off_t off = 0;
+            size_t len = 0;
+            ssize_t res = 0;
+            bool busy = false;
+            bool write = false;
+        };
+
+        bool Init()
+        {
+            if (m_buf)
+            {
+                return true;
+            }
+            if (!m_ring.Setup(SLOTS))
+            {
+                return false;
+            }
+            void* p = nullptr;
+            if (posix_memalign(&p, 4096, SLOTS * CHUNK) != 0)
+            {
+                return false;
+            }
+            m_buf.reset(static_cast<char*>(p));
+            iovec iov[SLOTS];
+            for (unsigned i = 0; i < SLOTS; i++)
+            {
+                iov[i] = {m_buf.get() + i * CHUNK, CHUNK};
+                m_free.push_back(static_cast<int>(i));
+            }
+            // pinned buffers skip the per request page mapping, plain requests work without them
+            m_fixed = m_ring.RegisterBuffers(iov, SLOTS);
+
+            return true;
+        }
+
+        void Queue(int id, uint8_t opcode)
+        {
+            const auto& slot = m_slots[id];
+            auto sqe = m_ring.Prepare();
+            sqe->opcode = opcode;
+            sqe->fd = m_fd;
+            sqe->off = static_cast<uint64_t>(slot.off);
+            sqe->addr = reinterpret_cast<uint64_t>(m_buf.get() + id * CHUNK);
+            sqe->len = static_cast<uint32_t>(slot.len);
+            sqe->buf_index = m_fixed ? static_cast<uint16_t>(id) : 0;
+            sqe->user_data = static_cast<uint64_t>(id);
+            m_slots[id].busy = true;
+        }
+
+        // Queues readahead chunks up to limit while slots are free
+        void Fill(off_t limit)
+        {
+            bool queued = false;
+            while (!m_free.empty() && m_winEnd < limit && (m_eofOff < 0 || m_winEnd < m_eofOff))
+            {
+                int id = m_free.back();
+                m_free.pop_back();
+                auto& slot = m_slots[id];
+                slot.off = m_winEnd;
+                slot.len = static_cast<size_t>(std::min<off_t>(CHUNK, limit - m_winEnd));
+                slot.write = false;
+                Queue(id, m_fixed ? IORING_OP_READ_FIXED : IORING_OP_READ);
+                m_window.push_back(id);
+                m_winEnd += slot.len;
+                queued = true;
+            }
+            if (queued)
+            {
+                m_good = m_good && m_ring.Enter(0);
+            }
+        }
+
+        bool InFlight() const
+        {
+            return std::any_of(std::begin(m_slots), std::end(m_slots), [](const Slot& slot) { return slot.busy; });
+        }
+
+        // Waits for one completion, false when the ring cannot be entered
+        bool WaitOne()
+        {
+            if (!m_ring.Enter(1))
+            {
+                m_good = false;
+                return false;
+            }
+            m_ring.Reap([this](uint64_t id, int res) {
+                auto& slot = m_slots[id];
+                slot.busy = false;
+                slot.res = res;
+                if (!slot.write)
+                {
+                    return;
+                }
+                // short writes are rare (signals, full disk), finish them synchronously
+                size_t done = res < 0 ? 0 : static_cast<size_t>(res);
+                while (res >= 0 && done < slot.len)
+                {
+                    auto ret = ::pwrite(m_fd, m_buf.get() + id * CHUNK + done, slot.len - done, slot.off + done);
+                    if (ret <= 0 && errno != EINTR)
+                    {
+                        break;
+                    }
+                    done += ret > 0 ? ret : 0;
+                }
+                m_good = m_good && done == slot.len;
+                m_free.push_back(static_cast<int>(id));
+            });
+
+            return true;
+        }
+
+        // Readahead that the next read does not continue is waited for and discarded
+        void DropWindow()
+        {
+            for (int id : m_window)
+            {
+                while (m_slots[id].busy && WaitOne())
+                {
+                }
+                // a chunk still in flight on a broken ring is not handed out again
+                if (!m_slots[id].busy)
+                {
+                    m_free.push_back(id);
+                }
+            }
+            m_window.clear();
+        }
+
+    private:
+        // the buffers outlive the ring they are registered with
+        std::unique_ptr<char, decltype(&free)> m_buf{nullptr, &free};
+        Ring m_ring;
+        bool m_async = false;
+        bool m_fixed = false;
+        Slot m_slots[SLOTS];
+        std::vector<int> m_free;
+        std::deque<int> m_window;
+        off_t m_winPos = 0;
+        off_t m_winEnd = 0;
+        off_t m_eofOff = -1;
+        off_t m_lastEnd = 0;
+    };
+}
+
+#endif
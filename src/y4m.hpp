@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "chroma_format.h"
+
+namespace y4m
+{
+    // YUV4MPEG2 stream header, frames follow as "FRAME[ params]\n" + planar data
+    struct Header
+    {
+        size_t w = 0;
+        size_t h = 0;
+        std::string fps = "25:1";
+        std::string interlace = "p";
+        std::string aspect = "0:0";
+        std::string colorspace = "420jpeg";
+    };
+
+    static constexpr const char* SIGNATURE = "YUV4MPEG2";
+    static constexpr const char* FRAME_MARKER = "FRAME";
+    static constexpr size_t MAX_LINE = 4096;
+
+    // Reads up to the next '\n'. A stream that can tell its position is read a block at a time and put back
+    // right after the newline, a pipe is read a byte at a time.
+    template <typename IStream>
+    bool ReadLine(IStream& s, std::string& line)
+    {
+        line.clear();
+        const auto pos = static_cast<std::streamoff>(s.tellg());
+        if (pos >= 0)
+        {
+            char block[MAX_LINE + 1];
+            s.read(block, sizeof(block));
+            const auto got = static_cast<size_t>(s.gcount());
+            auto end = static_cast<const char*>(std::memchr(block, '\n', got));
+            // a short read at the end of the stream is not an error yet
+            s.clear();
+            if (end == nullptr)
+            {
+                return false;
+            }
+            line.assign(block, static_cast<size_t>(end - block));
+            s.seekg(pos + (end - block) + 1, std::ios_base::beg);
+            return true;
+        }
+
+        char ch = 0;
+        while (s.read(&ch, 1), s.gcount() == 1)
+        {
+            if (ch == '\n')
+            {
+                return true;
+            }
+            if (line.size() == MAX_LINE)
+            {
+                return false;
+            }
+            line.push_back(ch);
+        }
+
+        return false;
+    }
+
+    // Reads the line in front of a frame. The usual bare "FRAME\n" takes a single read, pipes included; frame
+    // parameters after it are read as the rest of the line.
+    template <typename IStream>
+    bool ReadFrameLine(IStream& s, std::string& line)
+    {
+        const size_t size = std::strlen(FRAME_MARKER) + 1;
+        line.resize(size);
+        s.read(&line[0], size);
+        if (static_cast<size_t>(s.gcount()) != size)
+        {
+            return false;
+        }
+        if (line.back() == '\n')
+        {
+            line.pop_back();
+            return true;
+        }
+
+        std::string rest;
+        if (!ReadLine(s, rest))
+        {
+            return false;
+        }
+        line += rest;
+
+        return true;
+    }
+
+    inline bool Parse(const std::string& line, Header& hdr)
+    {
+        std::istringstream ss(line);
+        std::string token;
+        if (!(ss >> token) || token != SIGNATURE)
+        {
+            return false;
+        }
+
+        while (ss >> token)
+        {
+            auto value = token.substr(1);
+            switch (token[0])
+            {
+            case 'W':
+                hdr.w = strtoull(value.c_str(), nullptr, 10);
+                break;
+            case 'H':
+                hdr.h = strtoull(value.c_str(), nullptr, 10);
+                break;
+            case 'F':
+                hdr.fps = value;
+                break;
+            case 'I':
+                hdr.interlace = value;
+                break;
+            case 'A':
+                hdr.aspect = value;
+                break;
+            case 'C':
+                hdr.colorspace = value;
+                break;
+            default:
+                // X (vendor extension) tags may describe the old colorspace, drop them
+                break;
+            }
+        }
+
+        return hdr.w != 0 && hdr.h != 0;
+    }
+
+    inline std::string Format(const Header& hdr)
+    {
+        std::ostringstream ss;
+        ss << SIGNATURE << " W" << hdr.w << " H" << hdr.h << " F" << hdr.fps << " I" << hdr.interlace
+           << " A" << hdr.aspect << " C" << hdr.colorspace << "\n";
+
+        return ss.str();
+    }
+
+    // Maps a Y4M colorspace tag to the frame type name understood by the converter
+    inline const char* FrameType(const std::string& colorspace)
+    {
+        static const struct
+        {
+            const char* colorspace;
+            const char* type;
+        } table[] =
+        {
+            {"mono",     "I400"},
+            {"mono10",   "GRAY10LE"},
+            {"mono12",   "GRAY12LE"},
+            {"mono16",   "GRAY16LE"},
+            {"420",      "I420"},
+            {"420jpeg",  "I420"},
+            {"420mpeg2", "I420"},
+            {"420paldv", "I420"},
+            {"420p10",   "YUV420P10LE"},
+            {"420p12",   "YUV420P12LE"},
+            {"420p16",   "YUV420P16LE"},
+            {"422",      "I422"},
+            {"422p10",   "YUV422P10LE"},
+            {"422p12",   "YUV422P12LE"},
+            {"422p16",   "YUV422P16LE"},
+            {"444",      "I444"},
+            {"444p10",   "YUV444P10LE"},
+            {"444p12",   "YUV444P12LE"},
+            {"444p16",   "YUV444P16LE"},
+        };
+
+        for (const auto& entry : table)
+        {
+            if (colorspace == entry.colorspace)
+            {
+                return entry.type;
+            }
+        }
+
+        return "";
+    }
+
+    // Picks the Y4M colorspace closest to a frame's layout, 4:4:0 has no Y4M tag and is carried as 4:4:4
+    inline std::string ColorSpace(CHROMA_FORMAT fmt, uint8_t depth)
+    {
+        std::string cs;
+        switch (fmt)
+        {
+        case CHROMA_FORMAT::YUV_400:
+            return depth > 8 ? "mono" + std::to_string(depth) : "mono";
+        case CHROMA_FORMAT::YUV_420:
+            cs = depth > 8 ? "420" : "420jpeg";
+            break;
+        case CHROMA_FORMAT::YUV_422:
+            cs = "422";
+            break;
+        case CHROMA_FORMAT::YUV_440:
+        case CHROMA_FORMAT::YUV_444:
+        default:
+            cs = "444";
+            break;
+        }
+
+        return depth > 8 ? cs + "p" + std::to_string(depth) : cs;
+    }
+}
@@ -58,6 +58,17 @@ TestDataIStream& TestDataIStream::seekg(std::streampos pos)
     return *this;
 }
 
+TestDataIStream& TestDataIStream::seekg(std::streamoff off, std::ios_base::seekdir dir)
+{
+    auto size = m_data[m_file].second;
+    auto pos = dir == std::ios_base::end ? size + off : dir == std::ios_base::cur ? m_pos + off : off;
+    EXPECT_EQ(pos >= 0 && pos <= size, true);
+
+    m_pos = pos;
+
+    return *this;
+}
+
 std::streamsize TestDataIStream::GetFileSize(const std::string& filename) const
 {
     std::ifstream file(filename, std::ifstream::ate | std::ifstream::binary);
@@ -69,24 +80,28 @@ std::streamsize TestDataIStream::GetFileSize(const std::string& filename) const
 
 void TestDataOStream::open(const std::string& filename, std::ios_base::openmode mode)
 {
-    std::ignore = mode;
-
     m_file = filename;
-    _data.clear();
+    if (!(mode & std::ios_base::in))
+    {
+        _files[filename].clear();
+    }
+    _last = filename;
     m_pos = 0;
 }
 
 TestDataOStream& TestDataOStream::write(const char* s, std::streamsize n)
 {
-    if (_data.size() < m_pos + n)
+    auto& data = _files[m_file];
+    if (data.size() < m_pos + n)
     {
-        _data.resize(m_pos + n);
+        data.resize(m_pos + n);
     }
 
-    memcpy(_data.data() + m_pos, s, n);
+    memcpy(data.data() + m_pos, s, n);
     m_pos += n;
 
     return *this;
 }
 
-std::vector<char> TestDataOStream::_data;
+std::map<std::string, std::vector<char>> TestDataOStream::_files;
+std::string TestDataOStream::_last;
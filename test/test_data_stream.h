@@ -12,6 +12,14 @@ public:
     void open(const std::string& filename, std::ios_base::openmode mode);
     TestDataIStream& read(char* s, std::streamsize n);
     TestDataIStream& seekg(std::streampos pos);
+    TestDataIStream& seekg(std::streamoff off, std::ios_base::seekdir dir);
+
+    std::streampos tellg() const
+    {
+        return m_pos;
+    }
+
+    void clear() {}
 
     std::streamsize gcount() const
     {
@@ -41,18 +49,31 @@ public:
     void open(const std::string& filename, std::ios_base::openmode mode);
     TestDataOStream& write(const char* s, std::streamsize n);
 
+    TestDataOStream& seekp(std::streampos pos)
+    {
+        m_pos = pos;
+        return *this;
+    }
+
     operator bool() const
     {
         return !m_file.empty();
     }
 
+    // What was written to the last opened file, or to the given one
     static const std::vector<char>& Get()
     {
-        return _data;
+        return _files[_last];
+    }
+
+    static const std::vector<char>& Get(const std::string& filename)
+    {
+        return _files.at(filename);
     }
 
 private:
-    static std::vector<char> _data;
+    static std::map<std::string, std::vector<char>> _files;
+    static std::string _last;
     std::string m_file;
     std::streamsize m_pos = 0;
 };
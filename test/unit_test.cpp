@@ -1,6 +1,12 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 #include "../src/frame_converter.hpp"
+#include "../src/server.hpp"
+#include "../src/shm_ring.hpp"
 #include "gtest/gtest.h"
-#include "picosha2.h"
+#include "../src/picosha2.h"
 #include "sha256.h"
 #include "test_data_stream.h"
 
@@ -247,6 +253,1110 @@ TEST_F(FrameConverterTest, Padding)
     }
 }
 
+TEST_F(FrameConverterTest, Y4M)
+{
+    const char* y4mFile = "Test_1918x1078_1frameC444.y4m";
+    {
+        // I440 -> Y4M, 4:4:0 is carried as C444
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:i440", "Test_1918x1078_1frameI440", "-o:y4m", "out.y4m" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+
+        const auto& out = TestDataOStream::Get();
+        const std::string hdr = "YUV4MPEG2 W1918 H1078 F25:1 Ip A0:0 C444\nFRAME\n";
+        ASSERT_EQ(out.size(), hdr.size() + 1918 * 1078 * 3);
+        EXPECT_EQ(std::string(out.begin(), out.begin() + hdr.size()), hdr);
+        std::ofstream(y4mFile, std::ios::out | std::ios::binary).write(out.data(), out.size());
+    }
+    {
+        // Y4M -> I440, size and format come from the stream header
+        const char* cmdline[] = { "-i:y4m", y4mFile, "-o:i440", "out.yuv" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(GetSHA256(TestDataOStream::Get()), g_sha256Input.at(FOURCC::I440));
+    }
+    std::remove(y4mFile);
+
+    // lines read a block at a time end exactly after their newline, frame parameters included
+    {
+        std::ofstream("lines.y4m", std::ios::binary) << "YUV4MPEG2 W2 H2 C444\nFRAME Ip\nabcdefghijklFRAME\nmnopqrstuvwx";
+    }
+    std::ifstream fs("lines.y4m", std::ios::binary);
+    std::string line;
+    char frame[12];
+    EXPECT_TRUE(y4m::ReadLine(fs, line));
+    EXPECT_EQ(line, "YUV4MPEG2 W2 H2 C444");
+    EXPECT_TRUE(y4m::ReadFrameLine(fs, line));
+    EXPECT_EQ(line, "FRAME Ip");
+    EXPECT_EQ(fs.read(frame, sizeof(frame)).gcount(), 12);
+    EXPECT_EQ(std::string(frame, 12), "abcdefghijkl");
+    EXPECT_TRUE(y4m::ReadFrameLine(fs, line));
+    EXPECT_EQ(line, "FRAME");
+    EXPECT_EQ(fs.read(frame, sizeof(frame)).gcount(), 12);
+    EXPECT_EQ(std::string(frame, 12), "mnopqrstuvwx");
+    EXPECT_FALSE(y4m::ReadFrameLine(fs, line));
+    fs.close();
+    std::remove("lines.y4m");
+}
+
+TEST_F(FrameConverterTest, Hash)
+{
+    const char* hashFile = "out.sha256";
+    const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                              "--hash", hashFile, "--hash:in" };
+    converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+    EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+
+    std::ifstream ifs(hashFile);
+    std::string comment, index, out, in;
+    std::getline(ifs, comment);
+    ifs >> index >> out >> in;
+    EXPECT_EQ(index, "0");
+    EXPECT_EQ(out, g_sha256ChromaSampling422.at(FOURCC::I420));
+    EXPECT_EQ(in, g_sha256Input.at(FOURCC::YUYV));
+    ifs >> index >> out >> in;
+    EXPECT_EQ(index, "*");
+    EXPECT_EQ(out, GetSHA256(TestDataOStream::Get()));
+    EXPECT_EQ(in, g_sha256Input.at(FOURCC::YUYV));
+    ifs.close();
+    std::remove(hashFile);
+}
+
+TEST_F(FrameConverterTest, Compare)
+{
+    {
+        // I440 converted to 4:2:2 is bit exact with the YUYV test data
+        const char* cmdline[] = { "compare", "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-i:i440", "Test_1918x1078_1frameI440" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        auto report = testing::internal::GetCapturedStdout();
+        EXPECT_NE(report.find("frame 0: PSNR Y inf U inf V inf SSIM Y 1.0000 U 1.0000 V 1.0000 MAXDIFF Y 0 U 0 V 0"), std::string::npos);
+        EXPECT_NE(report.find("total: PSNR Y inf U inf V inf"), std::string::npos);
+    }
+    {
+        // luma of two different pictures
+        const char* cmdline[] = { "compare", "-w", "1918", "-h", "1078", "-i:i400", "Test_1918x1078_1frameI440", "-i:i400", "Test_1918x1078_1frameYUYV", "-n", "1" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        auto report = testing::internal::GetCapturedStdout();
+        EXPECT_NE(report.find("frame 0: PSNR Y 10.9866 SSIM Y 0.0326 MAXDIFF Y 215"), std::string::npos);
+    }
+    {
+        // compare walks the frames in order, a selection it would not honour is refused
+        const char* cmdline[] = { "compare", "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-i:yuyv", "Test_1918x1078_1frameYUYV",
+                                  "--every", "2", "--reverse" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+        auto report = testing::internal::GetCapturedStdout();
+        EXPECT_NE(report.find("compare cannot be used with --every"), std::string::npos);
+        EXPECT_NE(report.find("compare cannot be used with --reverse"), std::string::npos);
+    }
+}
+
+TEST_F(FrameConverterTest, Scaling)
+{
+    {
+        // bilinear resampling to the same size is an identity
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "-W", "1918", "-H", "1078", "--scale", "bilinear" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(GetSHA256(TestDataOStream::Get()), g_sha256ChromaSampling422.at(FOURCC::I420));
+    }
+    for (auto filter : { "bilinear", "area", "bicubic" })
+    {
+        // 4:4:0 chroma is scaled at its own size before the conversion to 4:2:0
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:i440", "Test_1918x1078_1frameI440", "-o:i420", "out.yuv",
+                                  "-W", "960", "-H", "540", "--scale", filter, "-a", "16" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(TestDataOStream::Get().size(), 960 * 544 * 3 / 2);
+    }
+    {
+        // the taps built for the first frame serve the next ones, and are rebuilt for another filter
+        std::vector<char> i420(64 * 32 * 3 / 2);
+        std::unique_ptr<frame::Frame> in(frame::Create("I420", 64, 32, "Input"));
+        std::unique_ptr<frame::Frame> reused(frame::Create("I420", 40, 20, "Scaled"));
+        in->Allocate();
+        reused->Allocate();
+        for (auto filter : { scaler::FILTER::BICUBIC, scaler::FILTER::BICUBIC, scaler::FILTER::AREA })
+        {
+            std::generate(i420.begin(), i420.end(), [n = static_cast<int>(filter)]() mutable { return static_cast<char>(n++ * 7); });
+            in->ReadFrame(i420.data());
+            std::unique_ptr<frame::Frame> fresh(frame::Create("I420", 40, 20, "Scaled"));
+            fresh->Allocate();
+            fresh->ScaleFrom(*in, filter);
+            reused->ScaleFrom(*in, filter);
+            EXPECT_EQ(reused->GetRaw().Y, fresh->GetRaw().Y);
+            EXPECT_EQ(reused->GetRaw().U, fresh->GetRaw().U);
+        }
+    }
+}
+
+TEST_F(FrameConverterTest, Crop)
+{
+    {
+        // a full frame window is the input itself
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:i440", "Test_1918x1078_1frameI440", "-o:i440", "out.yuv", "--crop", "0,0,1918,1078" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(GetSHA256(TestDataOStream::Get()), g_sha256Input.at(FOURCC::I440));
+    }
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv", "--crop", "64,32,320,200" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+
+        TestDataIStream ifs;
+        ifs.open("Test_1918x1078_1frameYUYV", std::ios::in | std::ios::binary);
+        std::vector<char> src(1918 * 1078 * 2);
+        ifs.read(src.data(), src.size());
+        std::vector<char> expected;
+        for (size_t y = 32; y < 32 + 200; y++)
+        {
+            auto row = src.begin() + (y * 1918 + 64) * 2;
+            expected.insert(expected.end(), row, row + 320 * 2);
+        }
+        EXPECT_EQ(TestDataOStream::Get(), expected);
+    }
+    {
+        // 4:2:2 cannot start on an odd column
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv", "--crop", "63,32,320,200" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+}
+
+TEST_F(FrameConverterTest, FrameSelection)
+{
+    // the 1918x1078 YUYV frame read as 1009 64x32 frames
+    const size_t frmSz = 64 * 32 * 2;
+    TestDataIStream ifs;
+    ifs.open("Test_1918x1078_1frameYUYV", std::ios::in | std::ios::binary);
+    std::vector<char> src(1918 * 1078 * 2);
+    ifs.read(src.data(), src.size());
+    auto expect = [&](std::initializer_list<size_t> frames) {
+        std::vector<char> expected;
+        for (auto f : frames)
+        {
+            expected.insert(expected.end(), src.begin() + f * frmSz, src.begin() + (f + 1) * frmSz);
+        }
+        EXPECT_EQ(TestDataOStream::Get(), expected);
+    };
+
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv", "-n:list", "0,5,10-12,1007-" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        expect({ 0, 5, 10, 11, 12, 1007, 1008 });
+    }
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv", "--every", "250" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        expect({ 0, 250, 500, 750, 1000 });
+    }
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv", "-n:list", "3,20-30", "--every", "4", "--reverse", "-n", "3" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        expect({ 30, 26, 22 });
+    }
+    {
+        // a list replaces the -n:beg/-n:end range
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv", "-n:list", "1-3", "-n:beg", "2" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+}
+
+TEST_F(FrameConverterTest, Threads)
+{
+    {
+        // more workers than frames, all pinned to one cpu
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:i440", "Test_1918x1078_1frameI440", "-o:i440", "out.yuv", "--threads", "3", "--cpus", "0" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(GetSHA256(TestDataOStream::Get()), g_sha256Input.at(FOURCC::I440));
+    }
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:i440", "Test_1918x1078_1frameI440", "-o:i440", "out.yuv", "--numa" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(GetSHA256(TestDataOStream::Get()), g_sha256Input.at(FOURCC::I440));
+    }
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:i440", "Test_1918x1078_1frameI440", "-o:i440", "out.yuv", "--cpus", "2-" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+}
+
+TEST_F(FrameConverterTest, MaxMemory)
+{
+    std::vector<char> expected;
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:p010", "out.yuv" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        expected = TestDataOStream::Get();
+    }
+    {
+        // a frame needs about 25 MiB, so it is converted in bands
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:p010", "out.yuv", "--max-memory", "4M" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        auto log = testing::internal::GetCapturedStdout();
+        EXPECT_EQ(TestDataOStream::Get(), expected);
+        EXPECT_NE(log.find("peak memory: "), std::string::npos);
+        EXPECT_NE(log.find(" rows in flight"), std::string::npos);
+    }
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:p010", "out.yuv", "--max-memory", "64M", "--threads", "8" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        auto log = testing::internal::GetCapturedStdout();
+        EXPECT_EQ(TestDataOStream::Get(), expected);
+        EXPECT_NE(log.find(", 2 frames in flight"), std::string::npos);
+    }
+    {
+        // bands cannot scale or hash, and say so
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:p010", "out.yuv", "--max-memory", "4M",
+                                  "-W", "960", "--hash", "out.sha256" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+        auto log = testing::internal::GetCapturedStdout();
+        EXPECT_NE(log.find("--max-memory below one frame cannot be used with -W/-H"), std::string::npos);
+        EXPECT_NE(log.find("--max-memory below one frame cannot be used with --hash"), std::string::npos);
+        std::remove("out.sha256");
+    }
+}
+
+TEST_F(FrameConverterTest, Strips)
+{
+    std::vector<char> expected;
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv", "--crop", "2,4,1600,900" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        expected = TestDataOStream::Get();
+    }
+    // 900 rows are not a multiple of 64, the last strip is shorter
+    for (auto rows : { "64", "auto" })
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv", "--crop", "2,4,1600,900", "--strip", rows };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(TestDataOStream::Get(), expected);
+    }
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv", "--strip", "0" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+}
+
+TEST_F(FrameConverterTest, FanOut)
+{
+    std::vector<std::vector<char>> expected;
+    for (auto type : { "-o:nv12", "-o:i420", "-o:p010" })
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", type, "out.yuv" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        expected.push_back(TestDataOStream::Get());
+    }
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV",
+                                  "-o:nv12", "out.nv12", "-o:i420", "out.i420", "-o:p010", "out.p010" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(TestDataOStream::Get("out.nv12"), expected[0]);
+        EXPECT_EQ(TestDataOStream::Get("out.i420"), expected[1]);
+        EXPECT_EQ(TestDataOStream::Get("out.p010"), expected[2]);
+    }
+}
+
+TEST_F(FrameConverterTest, SplitConcat)
+{
+    // the YUYV resource read as 1009 frames of 64x32
+    std::vector<char> frames;
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        frames = TestDataOStream::Get();
+    }
+    const size_t frmSz = 64 * 32 * 2;
+    {
+        const char* cmdline[] = { "split", "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "chunk_%02d.yuv",
+                                  "--chunk-frames", "100", "--threads", "1" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(TestDataOStream::Get("chunk_03.yuv"), std::vector<char>(frames.begin() + 300 * frmSz, frames.begin() + 400 * frmSz));
+        EXPECT_EQ(TestDataOStream::Get("chunk_10.yuv"), std::vector<char>(frames.begin() + 1000 * frmSz, frames.end()));
+    }
+    {
+        // the chunk size counts the converted frames, 100 I420 frames of 3072 bytes
+        const char* cmdline[] = { "split", "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "part_%02d.yuv",
+                                  "--chunk-size", "307200", "--threads", "2" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(TestDataOStream::Get("part_00.yuv").size(), 307200u);
+        EXPECT_EQ(TestDataOStream::Get("part_10.yuv").size(), 9u * 3072);
+    }
+    {
+        const char* cmdline[] = { "concat", "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-i:yuyv", "Test_1918x1078_1frameYUYV",
+                                  "-o:yuyv", "joined.yuv", "--threads", "1" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        auto expected = frames;
+        expected.insert(expected.end(), frames.begin(), frames.end());
+        EXPECT_EQ(TestDataOStream::Get("joined.yuv"), expected);
+    }
+    {
+        // split needs a chunk size
+        const char* cmdline[] = { "split", "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "chunk_%02d.yuv" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+}
+
+TEST_F(FrameConverterTest, Dedup)
+{
+    // repeated list entries read the same frame of the 64x32 sequence again
+    std::vector<char> all;
+    std::vector<char> unique;
+    for (auto list : { "5,5,5,6,7,7,5", "5,6,7,5" })
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "-n:list", list, "--threads", "2" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        (all.empty() ? all : unique) = TestDataOStream::Get();
+    }
+    for (auto mode : { "reuse", "drop" })
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "-n:list", "5,5,5,6,7,7,5", "--threads", "2", "--dedup", mode };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(TestDataOStream::Get(), std::strcmp(mode, "reuse") == 0 ? all : unique);
+    }
+    {
+        // a threshold needs a mode
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "--dedup-threshold", "1" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+    // the threshold is in samples of the input depth, whatever word holds them: every sample one step apart
+    for (auto type : { "I420", "P010", "P210", "Y210", "V210", "Y410", "V410" })
+    {
+        std::unique_ptr<frame::Frame> frm(frame::Create(type, 48, 32, "Input"));
+        const auto packing = frm->GetPacking();
+        const dedup::Samples samples{ packing.bytes, packing.count, packing.shift, frm->GetBitDepth() };
+        const size_t words = frm->FrameSize(false) / packing.bytes;
+        std::vector<char> a(frm->FrameSize(false));
+        std::vector<char> b(a.size());
+        for (size_t w = 0; w < words; w++)
+        {
+            uint32_t wa = 0;
+            uint32_t wb = 0;
+            for (size_t c = 0; c < packing.count; c++)
+            {
+                wa |= 100u << (packing.shift + c * frm->GetBitDepth());
+                wb |= 101u << (packing.shift + c * frm->GetBitDepth());
+            }
+            std::memcpy(a.data() + w * packing.bytes, &wa, packing.bytes);
+            std::memcpy(b.data() + w * packing.bytes, &wb, packing.bytes);
+        }
+        EXPECT_TRUE(dedup::Similar(a.data(), b.data(), a.size(), 1, samples)) << type;
+        EXPECT_FALSE(dedup::Similar(a.data(), b.data(), a.size(), 0.9, samples)) << type;
+    }
+}
+
+TEST_F(FrameConverterTest, V210V410)
+{
+    std::vector<char> source;
+    std::vector<char> v210;
+    for (auto type : { "-o:yuyv", "-o:v210" })
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", type, "out.yuv" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        (source.empty() ? source : v210) = TestDataOStream::Get();
+    }
+    // 320 groups of 6 pixels, 5120 bytes a row, already a multiple of 128
+    EXPECT_EQ(v210.size(), 5120u * 1078);
+
+    // 8-bit samples survive 10 bits and the 4:4:4 round trip
+    std::unique_ptr<frame::Frame> in(frame::Create("V210", 1918, 1078, "Input"));
+    std::unique_ptr<frame::Frame> full(frame::Create("V410", 1918, 1078, "Output"));
+    std::unique_ptr<frame::Frame> out(frame::Create("YUYV", 1918, 1078, "Output"));
+    in->Allocate();
+    in->ReadFrame(v210.data());
+    full->ConvertFrom(*in);
+    std::vector<char> v410(full->FrameSize(true));
+    full->WriteFrame(v410.data());
+    EXPECT_EQ(v410.size(), 4u * 1918 * 1078);
+    full->ReadFrame(v410.data());
+    out->ConvertFrom(*full);
+    std::vector<char> yuyv(out->FrameSize(true));
+    out->WriteFrame(yuyv.data());
+    EXPECT_EQ(yuyv, source);
+
+    // an odd width ends in a partial group whose last pixel keeps its chroma pair: 1917 = 319 groups + 3
+    std::unique_ptr<frame::Frame> odd(frame::Create("V210", 1917, 2, "Input"));
+    odd->SetPadding(2, false);
+    odd->Allocate();
+    std::vector<uint32_t> words(odd->FrameSize(false) / 4);
+    for (size_t i = 0; i < words.size(); i++)
+    {
+        words[i] = (i * 3 % 1024) | ((i * 3 + 1) % 1024) << 10 | ((i * 3 + 2) % 1024) << 20;
+    }
+    odd->ReadFrame(words.data());
+    // chroma 958 is u[1] and v[1] of group 319: bits 10-19 of its second word and bits 0-9 of its third
+    EXPECT_EQ(odd->GetRaw().U[958], words[319 * 4 + 1] >> 10 & 0x3FF);
+    EXPECT_EQ(odd->GetRaw().V[958], words[319 * 4 + 2] & 0x3FF);
+    EXPECT_EQ(odd->GetRaw().Y[1916], words[319 * 4 + 1] >> 20 & 0x3FF);
+}
+
+TEST_F(FrameConverterTest, MoveFrom)
+{
+    // three 64x32 NV12 frames cut from the YUYV resource
+    std::vector<char> nv12;
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:nv12", "out.yuv", "-n", "3" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        nv12 = TestDataOStream::Get();
+    }
+    const size_t frmSz = 64 * 32 * 3 / 2;
+    ASSERT_EQ(nv12.size(), frmSz * 3);
+
+    for (auto type : { "I420", "P010" })
+    {
+        std::unique_ptr<frame::Frame> in(frame::Create("NV12", 64, 32, "Input"));
+        std::unique_ptr<frame::Frame> moved(frame::Create(type, 64, 32, "Output"));
+        std::unique_ptr<frame::Frame> copied(frame::Create(type, 64, 32, "Output"));
+        in->Allocate();
+        for (size_t f = 0; f < 3; f++)
+        {
+            in->ReadFrame(nv12.data() + frmSz * f);
+            copied->ConvertFrom(*in);
+            const auto* y = in->GetRaw().Y.data();
+            const auto* u = in->GetRaw().U.data();
+            moved->MoveFrom(*in);
+
+            std::vector<char> expected(copied->FrameSize(true));
+            std::vector<char> output(moved->FrameSize(true));
+            copied->WriteFrame(expected.data());
+            moved->WriteFrame(output.data());
+            EXPECT_EQ(output, expected);
+            // only a repack hands the planes over, once the output has planes to give back
+            bool repack = std::strcmp(type, "I420") == 0 && f > 0;
+            EXPECT_EQ(moved->GetRaw().Y.data() == y, repack);
+            EXPECT_EQ(moved->GetRaw().U.data() == u, repack);
+            EXPECT_EQ(in->GetRaw().Y.size(), moved->GetRaw().Y.size());
+        }
+    }
+}
+
+TEST_F(FrameConverterTest, Color)
+{
+    // a range change alone round trips every legal 8-bit code through full range
+    color::Spec toFull;
+    toFull.rangeOut = color::RANGE::FULL;
+    color::Spec toLimited;
+    toLimited.rangeIn = color::RANGE::FULL;
+    {
+        color::Transform there(toFull, 8, 8);
+        color::Transform back(toLimited, 8, 8);
+        std::vector<uint16_t> codes(256);
+        for (uint16_t i = 0; i < 256; i++)
+        {
+            codes[i] = i;
+        }
+        std::vector<uint16_t> full(256), limited(256), fullU(256), fullV(256), limitedU(256), limitedV(256);
+        there.Luma<false>(codes.data(), nullptr, nullptr, full.data(), 256);
+        back.Luma<false>(full.data(), nullptr, nullptr, limited.data(), 256);
+        there.Chroma(codes.data(), codes.data(), fullU.data(), fullV.data(), 256);
+        back.Chroma(fullU.data(), fullV.data(), limitedU.data(), limitedV.data(), 256);
+        EXPECT_EQ(full[16], 0);
+        EXPECT_EQ(full[235], 255);
+        EXPECT_EQ(full[0], 0);
+        EXPECT_EQ(fullU[128], 128);
+        for (uint16_t i = 16; i <= 240; i++)
+        {
+            EXPECT_EQ(limitedU[i], i);
+            EXPECT_EQ(limitedV[i], i);
+            if (i <= 235)
+            {
+                EXPECT_EQ(limited[i], i);
+            }
+        }
+    }
+
+    // BT.601 to BT.709 through a frame, 8-bit I420 to P010, grey keeps its luma
+    std::unique_ptr<frame::Frame> in(frame::Create("I420", 4, 4, "Input"));
+    std::unique_ptr<frame::Frame> out(frame::Create("P010", 4, 4, "Output"));
+    std::unique_ptr<frame::Frame> back(frame::Create("I420", 4, 4, "Output"));
+    color::Spec matrix;
+    matrix.matrixIn = color::MATRIX::BT601;
+    out->SetColor(matrix);
+    std::swap(matrix.matrixIn, matrix.matrixOut);
+    back->SetColor(matrix);
+    in->Allocate();
+    for (auto sample : { std::array<uint8_t, 3>{ 126, 128, 128 }, std::array<uint8_t, 3>{ 126, 16, 240 } })
+    {
+        std::vector<uint8_t> i420(24, sample[0]);
+        std::fill(i420.begin() + 16, i420.begin() + 20, sample[1]);
+        std::fill(i420.begin() + 20, i420.end(), sample[2]);
+        in->ReadFrame(i420.data());
+        out->MoveFrom(*in);
+        const auto& raw = out->GetRaw();
+        const bool grey = sample[1] == 128;
+        // 462.6, 107.0 and 937.7 in floating point
+        EXPECT_EQ(raw.Y[0], grey ? 126 * 4 : 463);
+        EXPECT_EQ(raw.U[0], grey ? 512 : 107);
+        EXPECT_EQ(raw.V[0], grey ? 512 : 938);
+        // the output converted the planes, the input still has its own
+        EXPECT_NE(raw.Y.data(), in->GetRaw().Y.data());
+
+        back->ConvertFrom(*out);
+        EXPECT_NEAR(back->GetRaw().Y[0], sample[0], 1);
+        EXPECT_NEAR(back->GetRaw().U[0], sample[1], 1);
+        EXPECT_NEAR(back->GetRaw().V[0], sample[2], 1);
+    }
+
+    {
+        // compare measures what it reads
+        const char* cmdline[] = { "compare", "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV",
+                                  "-i:yuyv", "Test_1918x1078_1frameYUYV", "--range", "limited:full" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "--matrix", "709:470" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+}
+
+TEST_F(FrameConverterTest, Fields)
+{
+    // the resource read as 64x32 I420 frames, or as 64x16 I420 fields
+    std::vector<char> frames;
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:i420", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv", "-n", "6" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        frames = TestDataOStream::Get();
+    }
+    const size_t frmSz = 64 * 32 * 3 / 2;
+    ASSERT_EQ(frames.size(), frmSz * 6);
+    // the rows of one parity of an I420 frame, chroma rows alternate between the fields like luma rows
+    auto field = [](const char* frm, size_t parity) {
+        std::vector<char> rows;
+        for (auto plane : { std::array<size_t, 3>{ 0, 64, 32 }, std::array<size_t, 3>{ 64 * 32, 32, 16 },
+                            std::array<size_t, 3>{ 64 * 32 * 5 / 4, 32, 16 } })
+        {
+            for (size_t r = parity; r < plane[2]; r += 2)
+            {
+                const char* row = frm + plane[0] + plane[1] * r;
+                rows.insert(rows.end(), row, row + plane[1]);
+            }
+        }
+        return rows;
+    };
+
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:i420", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "--fields", "split", "-n:beg", "1", "-n", "4", "--threads", "3" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        std::vector<char> expected;
+        for (size_t f = 1; f < 5; f++)
+        {
+            for (size_t parity = 0; parity < 2; parity++)
+            {
+                auto rows = field(frames.data() + frmSz * f, parity);
+                expected.insert(expected.end(), rows.begin(), rows.end());
+            }
+        }
+        EXPECT_EQ(TestDataOStream::Get(), expected);
+    }
+    {
+        // every two fields of the stream make a frame
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:i420", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "--fields", "weave", "-n", "3", "--threads", "2" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        const auto& woven = TestDataOStream::Get();
+        ASSERT_EQ(woven.size(), frmSz * 3);
+        for (size_t f = 0; f < 3; f++)
+        {
+            for (size_t parity = 0; parity < 2; parity++)
+            {
+                const char* src = frames.data() + frmSz * f + frmSz / 2 * parity;
+                EXPECT_EQ(field(woven.data() + frmSz * f, parity), std::vector<char>(src, src + frmSz / 2));
+            }
+        }
+    }
+    {
+        // v210 rows of 128 pixels are not two rows of 64
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:v210", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "--fields", "split" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+    {
+        // every option fields cannot be used with is named
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "--fields", "split", "--reverse", "--crop", "0,0,32,16" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+        auto report = testing::internal::GetCapturedStdout();
+        EXPECT_NE(report.find("--fields cannot be used with --crop"), std::string::npos);
+        EXPECT_NE(report.find("--fields cannot be used with --reverse"), std::string::npos);
+        EXPECT_EQ(report.find("--dedup"), std::string::npos);
+    }
+}
+
+TEST_F(FrameConverterTest, Tiled)
+{
+    std::vector<std::vector<char>> outputs;
+    for (auto type : { "-o:nv12", "-o:nv12_4l4", "-o:nv12_ytile" })
+    {
+        const char* cmdline[] = { "-w", "1918", "-h", "1078", "-i:yuyv", "Test_1918x1078_1frameYUYV", type, "out.yuv" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        outputs.push_back(TestDataOStream::Get());
+    }
+    // planes padded to whole tiles, 1920x1080 + 1920x540 for 4x4 tiles, 1920x1088 + 1920x544 for Y-tiles
+    EXPECT_EQ(outputs[1].size(), 1920u * (1080 + 540));
+    EXPECT_EQ(outputs[2].size(), 1920u * (1088 + 544));
+
+    for (auto type : { "NV12_4L4", "NV12_YTILE" })
+    {
+        std::unique_ptr<frame::Frame> tiled(frame::Create(type, 1918, 1078, "Input"));
+        std::unique_ptr<frame::Frame> linear(frame::Create("NV12", 1918, 1078, "Output"));
+        tiled->Allocate();
+        tiled->ReadFrame(outputs[std::strcmp(type, "NV12_4L4") == 0 ? 1 : 2].data());
+        linear->ConvertFrom(*tiled);
+        std::vector<char> nv12(linear->FrameSize(true));
+        linear->WriteFrame(nv12.data());
+        EXPECT_EQ(nv12, outputs[0]);
+    }
+}
+
+#if !defined(_WIN32)
+TEST_F(FrameConverterTest, DirectSeek)
+{
+    // the bands of --max-memory, split/concat jobs and --resume write by offset
+    struct Probe : io::File
+    {
+        Probe() : io::File(true) {}
+        bool DirectOn() const
+        {
+            return m_directOn;
+        }
+    };
+    const char* path = "direct_seek.yuv";
+    std::vector<char> data(3 * 4096 + 100);
+    std::generate(data.begin(), data.end(), [n = 0]() mutable { return static_cast<char>(n++ * 13); });
+    {
+        Probe fs;
+        fs.open(path, std::ios::out | std::ios::binary);
+        ASSERT_TRUE(fs);
+        if (!fs.DirectOn())
+        {
+            std::remove(path);
+            GTEST_SKIP() << "no O_DIRECT on this filesystem";
+        }
+        fs.write(data.data(), data.size());
+        // staging goes on from a sector, an unaligned offset is written through the page cache
+        fs.seekp(8 * 4096);
+        EXPECT_TRUE(fs.DirectOn());
+        fs.write(data.data(), data.size());
+        fs.seekp(16 * 4096 + 100);
+        EXPECT_FALSE(fs.DirectOn());
+        fs.write(data.data(), 100);
+        fs.seekp(20 * 4096);
+        EXPECT_TRUE(fs.DirectOn());
+        fs.write(data.data(), 4096);
+        EXPECT_TRUE(fs);
+    }
+
+    std::ifstream ifs(path, std::ios::binary);
+    std::vector<char> out((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(out.size(), 21u * 4096);
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), out.begin()));
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), out.begin() + 8 * 4096));
+    EXPECT_TRUE(std::equal(data.begin(), data.begin() + 100, out.begin() + 16 * 4096 + 100));
+    EXPECT_TRUE(std::equal(data.begin(), data.begin() + 4096, out.begin() + 20 * 4096));
+    std::remove(path);
+}
+#endif
+
+TEST_F(FrameConverterTest, Resume)
+{
+    // --resume works on files, the YUYV resource is copied out as 1009 frames of 64x32
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        auto frames = TestDataOStream::Get();
+        std::ofstream("resume_in.yuv", std::ios::binary).write(frames.data(), frames.size());
+    }
+    auto load = [](const char* path) {
+        std::ifstream ifs(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    };
+    const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "resume_in.yuv", "-o:i420", "resume_out.yuv",
+                              "--hash", "resume_out.sha256", "--threads", "3", "--resume" };
+    const int argc = sizeof(cmdline) / sizeof(cmdline[0]);
+    {
+        converter::FrameConverter<std::ifstream, std::ofstream> cvt;
+        EXPECT_EQ(cvt.Execute(argc - 1, cmdline), 0);
+    }
+    const auto output = load("resume_out.yuv");
+    const auto sidecar = load("resume_out.sha256");
+
+    // killed in the middle of frame 500, with frame 100 damaged: both are converted again
+    const size_t frmSz = 64 * 32 * 3 / 2;
+    {
+        std::ofstream ofs("resume_out.yuv", std::ios::binary);
+        ofs.write(output.data(), frmSz * 500 + 7);
+        ofs.seekp(frmSz * 100);
+        ofs.put(~output[frmSz * 100]);
+    }
+    {
+        converter::FrameConverter<std::ifstream, std::ofstream> cvt;
+        EXPECT_EQ(cvt.Execute(argc, cmdline), 0);
+    }
+    EXPECT_EQ(load("resume_out.yuv"), output);
+    EXPECT_EQ(load("resume_out.sha256"), sidecar);
+    {
+        // without --hash the kept frames are taken from the file size and not read back, a damaged one stays
+        std::ofstream ofs("resume_out.yuv", std::ios::binary);
+        ofs.write(output.data(), frmSz * 500 + 7);
+        ofs.seekp(frmSz * 100);
+        ofs.put(~output[frmSz * 100]);
+    }
+    {
+        const char* plain[] = { "-w", "64", "-h", "32", "-i:yuyv", "resume_in.yuv", "-o:i420", "resume_out.yuv", "--threads", "3",
+                                "--resume" };
+        converter::FrameConverter<std::ifstream, std::ofstream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(plain) / sizeof(plain[0]), plain), 0);
+        EXPECT_NE(testing::internal::GetCapturedStdout().find("Resuming after 500 frames"), std::string::npos);
+        auto expected = output;
+        expected[frmSz * 100] = ~expected[frmSz * 100];
+        EXPECT_EQ(load("resume_out.yuv"), expected);
+    }
+    {
+        // nothing to resume on stdout
+        const char* pipe[] = { "-w", "64", "-h", "32", "-i:yuyv", "resume_in.yuv", "-o:i420", "-", "--resume" };
+        converter::FrameConverter<std::ifstream, std::ofstream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(pipe) / sizeof(pipe[0]), pipe), -1);
+    }
+    std::remove("resume_in.yuv");
+    std::remove("resume_out.yuv");
+    std::remove("resume_out.sha256");
+}
+
+TEST_F(FrameConverterTest, Progress)
+{
+    // the total announced up front is what the cursor hands out
+    for (const char* list : { "0-99", "3,20-30,7-9", "5-" })
+    {
+        for (size_t step : { 1, 3, 7 })
+        {
+            for (size_t limit : { size_t(4), static_cast<size_t>(-1) })
+            {
+                std::vector<selection::Range> ranges;
+                EXPECT_TRUE(selection::Parse(list, ranges));
+                selection::Cursor cursor(ranges, step, false, limit, 50);
+                const size_t count = cursor.Count();
+                size_t index[16];
+                size_t n = 0;
+                for (size_t got; (got = cursor.Next(index, 16)) > 0;)
+                {
+                    n += got;
+                    EXPECT_EQ(cursor.Count(), count - n);
+                }
+                EXPECT_EQ(count, n);
+            }
+        }
+    }
+
+    // one JSON line per interval and a last one when the reporter goes
+    progress::Counters counters;
+    std::ostringstream os;
+    {
+        progress::Reporter reporter(counters, 3, os, std::chrono::milliseconds(10));
+        for (int f = 0; f < 3; f++)
+        {
+            progress::Add(counters.frames, 1);
+            progress::Add(counters.bytesOut, 1000000);
+            std::this_thread::sleep_for(std::chrono::milliseconds(15));
+        }
+    }
+    std::string lines = os.str();
+    EXPECT_GT(std::count(lines.begin(), lines.end(), '\n'), 1);
+    lines.pop_back();
+    const std::string last = lines.substr(lines.rfind('\n') + 1);
+    EXPECT_EQ(last.compare(0, 22, "{\"frames\":3,\"total\":3,"), 0);
+    EXPECT_NE(last.find("\"eta\":0.00,\"done\":true,\"ok\":false}"), std::string::npos);
+
+    // both spellings of the option, the last line carries the outcome of the job
+    for (auto option : { "--progress=json", "--progress" })
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv", "-n", "3",
+                                  option, "json" };
+        const int argc = sizeof(cmdline) / sizeof(cmdline[0]) - (std::strchr(option, '=') ? 1 : 0);
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStderr();
+        EXPECT_EQ(cvt.Execute(argc, cmdline), 0);
+        auto report = testing::internal::GetCapturedStderr();
+        EXPECT_NE(report.find("{\"frames\":3,\"total\":3,"), std::string::npos) << option;
+        EXPECT_NE(report.find("\"done\":true,\"ok\":true}"), std::string::npos) << option;
+    }
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv",
+                                  "--progress=text" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStderr();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+        EXPECT_NE(testing::internal::GetCapturedStderr().find("--progress takes json"), std::string::npos);
+    }
+}
+
+#if !defined(_WIN32)
+TEST_F(FrameConverterTest, Serve)
+{
+    // the conversion is stubbed, the daemon's part is the protocol and what it passes on
+    const char* path = "yuv_tools_test.sock";
+    std::mutex mutex;
+    std::vector<std::vector<std::string>> seen;
+    std::vector<pool::Workers*> pools;
+    server::Server srv(2, 8, [&](int argc, char** argv, pool::Workers* workers, pool::Buffers* buffers) {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen.emplace_back(argv, argv + argc);
+        EXPECT_NE(buffers, nullptr);
+        pools.push_back(workers);
+        return seen.back()[0] == "-w" ? 0 : -1;
+    });
+    std::thread daemon([&]() { EXPECT_EQ(srv.Run(path), 0); });
+
+    int fd = -1;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path);
+    for (int retry = 0; retry < 100 && fd < 0; retry++)
+    {
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+        {
+            ::close(fd);
+            fd = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    ASSERT_GE(fd, 0);
+
+    // a request with a descriptor, then one the stub fails and one naming a descriptor that was not passed
+    const char first[] = "-w\0" "64\0" "-i:yuyv\0" "&0\0" "\0";
+    int passed = ::open("/dev/null", O_RDONLY);
+    iovec iov = { const_cast<char*>(first), sizeof(first) - 1 };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cm), &passed, sizeof(int));
+    EXPECT_EQ(::sendmsg(fd, &msg, 0), static_cast<ssize_t>(sizeof(first) - 1));
+    ::close(passed);
+    const char rest[] = "-x\0" "--threads\0" "1\0" "\0" "-w\0" "&1\0" "\0";
+    EXPECT_EQ(::send(fd, rest, sizeof(rest) - 1, 0), static_cast<ssize_t>(sizeof(rest) - 1));
+
+    std::string replies;
+    while (std::count(replies.begin(), replies.end(), '\n') < 3)
+    {
+        char buf[64];
+        auto got = ::recv(fd, buf, sizeof(buf), 0);
+        ASSERT_GT(got, 0);
+        replies.append(buf, got);
+    }
+    for (const char* reply : { "0 0\n", "1 -1\n", "2 -1\n" })
+    {
+        EXPECT_NE(replies.find(reply), std::string::npos);
+    }
+    std::raise(SIGTERM);
+    daemon.join();
+    ::close(fd);
+
+    // the descriptor is opened again by path, a job gets its share of the threads and runs quietly
+    ASSERT_EQ(seen.size(), 2u);
+    std::sort(seen.begin(), seen.end());
+    EXPECT_EQ(seen[0][3].compare(0, 8, "/dev/fd/"), 0);
+    EXPECT_EQ(std::vector<std::string>(seen[0].begin() + 4, seen[0].end()), std::vector<std::string>({ "--threads", "4", "--quiet" }));
+    EXPECT_EQ(seen[1], std::vector<std::string>({ "-x", "--threads", "1", "--quiet" }));
+    // every job borrows the same threads
+    ASSERT_EQ(pools.size(), 2u);
+    EXPECT_NE(pools[0], nullptr);
+    EXPECT_EQ(pools[0], pools[1]);
+}
+TEST_F(FrameConverterTest, Pools)
+{
+    // a task that waits for tasks of its own does not starve a pool of one thread
+    pool::Workers workers(1);
+    std::atomic<int> ran{ 0 };
+    auto outer = workers.Submit([&]() {
+        std::vector<std::future<void>> inner;
+        for (int i = 0; i < 4; i++)
+        {
+            inner.push_back(workers.Submit([&]() { ran++; }));
+        }
+        for (auto& task : inner)
+        {
+            workers.Wait(task);
+        }
+    });
+    workers.Wait(outer);
+    EXPECT_EQ(ran, 4);
+
+    // a buffer comes back for the same size, the free ones stay within the limit
+    pool::Buffers buffers(1000);
+    char* first = nullptr;
+    {
+        auto buf = pool::Take(&buffers, 600);
+        first = buf.get();
+    }
+    EXPECT_EQ(buffers.Kept(), 600u);
+    {
+        auto buf = pool::Take(&buffers, 600);
+        EXPECT_EQ(buf.get(), first);
+        EXPECT_EQ(buffers.Kept(), 0u);
+        auto other = pool::Take(&buffers, 500);
+    }
+    EXPECT_EQ(buffers.Kept(), 500u);
+    EXPECT_EQ(pool::Take(nullptr, 16).get_deleter().pool, nullptr);
+
+    // a converter on the pools writes what one on its own threads does
+    const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv", "-n", "3", "--threads", "2" };
+    std::vector<char> expected;
+    {
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        expected = TestDataOStream::Get();
+    }
+    for (int job = 0; job < 2; job++)
+    {
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        cvt.SetPools(&workers, &buffers);
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        EXPECT_EQ(TestDataOStream::Get(), expected);
+    }
+    EXPECT_GT(buffers.Kept(), 0u);
+}
+TEST_F(FrameConverterTest, ShmRing)
+{
+    // 20 frames of 64x32 YUYV pass through a ring of 3 slots in and a ring of 2 slots out
+    const size_t frames = 20;
+    const size_t frmSzIn = 64 * 32 * 2;
+    const size_t frmSzOut = 64 * 32 * 3 / 2;
+    std::vector<char> input;
+    std::vector<char> expected;
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:yuyv", "out.yuv", "-n", "20" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        input = TestDataOStream::Get();
+    }
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "out.yuv", "-n", "20" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+        expected = TestDataOStream::Get();
+    }
+    ASSERT_EQ(input.size(), frames * frmSzIn);
+
+    ::shm_unlink("/yuv_tools_test_in");
+    ::shm_unlink("/yuv_tools_test_out");
+    ASSERT_TRUE(io::ShmRing::Create("/yuv_tools_test_in", frmSzIn, 3));
+    ASSERT_TRUE(io::ShmRing::Create("/yuv_tools_test_out", frmSzOut, 2));
+    EXPECT_FALSE(io::ShmRing::Create("/yuv_tools_test_out", frmSzOut, 2));
+
+    // the producer hands over one frame per slot, the consumer drains whatever was published
+    std::thread producer([&]() {
+        int fd = ::shm_open("/yuv_tools_test_in", O_RDWR, 0);
+        io::ShmRing ring;
+        ASSERT_TRUE(ring.Attach(fd, true));
+        for (size_t i = 0; i < frames; i++)
+        {
+            EXPECT_TRUE(ring.Write(input.data() + i * frmSzIn, frmSzIn));
+        }
+        ring.Detach();
+        ::close(fd);
+    });
+    std::vector<char> output;
+    std::thread consumer([&]() {
+        int fd = ::shm_open("/yuv_tools_test_out", O_RDWR, 0);
+        io::ShmRing ring;
+        ASSERT_TRUE(ring.Attach(fd, false));
+        char buf[1000];
+        for (size_t got; (got = ring.Read(buf, sizeof(buf))) > 0;)
+        {
+            output.insert(output.end(), buf, buf + got);
+        }
+        ::close(fd);
+    });
+    {
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "shm:/yuv_tools_test_in", "-o:i420", "shm:/yuv_tools_test_out",
+                                  "--threads", "2" };
+        converter::FrameConverter<io::ShmFile, io::ShmFile> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), 0);
+    }
+    producer.join();
+    consumer.join();
+    EXPECT_EQ(output, expected);
+
+    {
+        // no such ring
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "shm:/yuv_tools_test_none", "-o:i420", "out.yuv" };
+        converter::FrameConverter<io::ShmFile, TestDataOStream> cvt;
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+    }
+    {
+        // the file next to a ring could not get the backend asked for
+        const char* cmdline[] = { "-w", "64", "-h", "32", "-i:yuyv", "Test_1918x1078_1frameYUYV", "-o:i420", "shm:/yuv_tools_test_out",
+                                  "--io", "direct" };
+        converter::FrameConverter<TestDataIStream, TestDataOStream> cvt;
+        testing::internal::CaptureStdout();
+        EXPECT_EQ(cvt.Execute(sizeof(cmdline) / sizeof(cmdline[0]), cmdline), -1);
+        EXPECT_NE(testing::internal::GetCapturedStdout().find("--io direct cannot be used with a shared memory ring"), std::string::npos);
+    }
+    ::shm_unlink("/yuv_tools_test_in");
+    ::shm_unlink("/yuv_tools_test_out");
+}
+#endif
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);